@@ -40,6 +40,8 @@
 #include <linux/module.h>
 #include <linux/mutex.h>
 #include <asm/io.h>         /* For inb() and outb() */
+#include "ec.h"
+#include "eeefsb_trace.h"
 
 #define EC_IDX_ADDRH 0x381
 #define EC_IDX_ADDRL 0x382
@@ -50,11 +52,14 @@ static DEFINE_MUTEX(eeefsb_ec_mutex);
 
 static unsigned char eeefsb_ec_read(unsigned short addr) {
     unsigned char data;
+    u64 t;
 
     mutex_lock(&eeefsb_ec_mutex);
+    t = eeefsb_trace_clock();
     outb(HIGH_BYTE(addr), EC_IDX_ADDRH);
     outb(LOW_BYTE(addr), EC_IDX_ADDRL);
     data = inb(EC_IDX_DATA);
+    eeefsb_trace_record(EEEFSB_TRACE_EC_READ, addr, &data, 1, 1, t);
     mutex_unlock(&eeefsb_ec_mutex);
 
     return data;
@@ -62,10 +67,55 @@ static unsigned char eeefsb_ec_read(unsigned short addr) {
 
 static void eeefsb_ec_write(unsigned short addr, unsigned char data)
 {
+    u64 t;
+
     mutex_lock(&eeefsb_ec_mutex);
+    t = eeefsb_trace_clock();
     outb(HIGH_BYTE(addr), EC_IDX_ADDRH);
     outb(LOW_BYTE(addr), EC_IDX_ADDRL);
     outb(data, EC_IDX_DATA);
+    eeefsb_trace_record(EEEFSB_TRACE_EC_WRITE, addr, &data, 1, 1, t);
+    mutex_unlock(&eeefsb_ec_mutex);
+}
+
+/* Bulk Index IO transfers                                                    *
+ * The whole range is done under a single hold of the EC mutex; the high     *
+ * address byte is only rewritten when a page boundary is crossed.           */
+void eeefsb_ec_read_block(unsigned short addr, unsigned char *buf, int len)
+{
+    unsigned int a = addr;
+    int i;
+    u64 t;
+
+    mutex_lock(&eeefsb_ec_mutex);
+    t = eeefsb_trace_clock();
+    outb(HIGH_BYTE(a), EC_IDX_ADDRH);
+    for (i = 0; i < len; i++, a++) {
+        if (i > 0 && LOW_BYTE(a) == 0)
+            outb(HIGH_BYTE(a), EC_IDX_ADDRH);
+        outb(LOW_BYTE(a), EC_IDX_ADDRL);
+        buf[i] = inb(EC_IDX_DATA);
+    }
+    eeefsb_trace_record(EEEFSB_TRACE_EC_READ, addr, buf, len, len, t);
+    mutex_unlock(&eeefsb_ec_mutex);
+}
+
+void eeefsb_ec_write_block(unsigned short addr, const unsigned char *buf, int len)
+{
+    unsigned int a = addr;
+    int i;
+    u64 t;
+
+    mutex_lock(&eeefsb_ec_mutex);
+    t = eeefsb_trace_clock();
+    outb(HIGH_BYTE(a), EC_IDX_ADDRH);
+    for (i = 0; i < len; i++, a++) {
+        if (i > 0 && LOW_BYTE(a) == 0)
+            outb(HIGH_BYTE(a), EC_IDX_ADDRH);
+        outb(LOW_BYTE(a), EC_IDX_ADDRL);
+        outb(buf[i], EC_IDX_DATA);
+    }
+    eeefsb_trace_record(EEEFSB_TRACE_EC_WRITE, addr, buf, len, len, t);
     mutex_unlock(&eeefsb_ec_mutex);
 }
 
@@ -40,6 +40,9 @@
 #define _EC_H_
 /*unsigned char eeefsb_ec_read(unsigned short addr);
 void eeefsb_ec_write(unsigned short addr, unsigned char data); */
+#define EEEFSB_EC_SIZE 0x10000 /* Index IO address space */
+void eeefsb_ec_read_block(unsigned short addr, unsigned char *buf, int len);
+void eeefsb_ec_write_block(unsigned short addr, const unsigned char *buf, int len);
 void eeefsb_ec_gpio_set(int pin, int value);
 int eeefsb_ec_gpio_get(int pin);
 int eeefsb_get_voltage(void);
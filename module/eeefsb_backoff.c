@@ -0,0 +1,234 @@
+/*
+ *  eeefsb_backoff.c - hardware error driven clock back-off
+ *
+ *  Copyright (C) 2012 Olli Vanhoja
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  Ths program is distributed in the hope that it will be useful,
+ *  but WITOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTAILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Template Place, Suite 330, Boston, MA  02111-1307 USA
+ *  
+ *  ---------
+ *
+ *  This code comes WITHOUT ANY WARRANTY whatsoever.
+ */
+
+/*** Hardware error back-off **************************************************
+ * A marginal overclock first shows up as machine checks or oopses rather     *
+ * than a dead machine. We listen to the MCE decoder chain and the die        *
+ * notifier; an error during a ramp or within the configured window after    *
+ * the last clock change marks the current operating point as failing and     *
+ * lowers the ceiling to "steps" N units below it through the "backoff" QoS   *
+ * request. Failing points are kept for the rest of the uptime. They can be   *
+ * read from /proc/eeefsb/backoff and written back after boot to persist.     *
+ *                                                                            *
+ * The MCE chain can be called from the #MC handler and the die chain from   *
+ * any context, so the notifiers only count the event. A work item polls the  *
+ * count every EEEFSB_BACKOFF_POLL and does the real work.                    *
+ */
+#include <linux/kernel.h>
+#include <linux/module.h>
+#include <linux/mutex.h>
+#include <linux/workqueue.h>
+#include <linux/percpu.h>
+#include <linux/notifier.h>
+#include <linux/kdebug.h>
+#include <asm/mce.h>
+#include "options.h"
+#include "pll.h"
+#include "eeefsb_wq.h"
+#include "eeefsb_qos.h"
+#include "eeefsb_backoff.h"
+
+#define EEEFSB_BACKOFF_POLL HZ /* Poll period for new errors [jiffy] */
+
+static struct eeefsb_backoff_state backoff = {
+    .steps  = EEEFSB_BACKOFF_STEPS,
+    .window = EEEFSB_BACKOFF_WINDOW,
+};
+static struct eeefsb_qos_request eeefsb_backoff_qos;
+static atomic_t backoff_pending = ATOMIC_INIT(0);
+/* Registers of the last GPF on each CPU, the oops that follows is the same */
+static DEFINE_PER_CPU(struct pt_regs *, backoff_gpf_regs);
+static DEFINE_MUTEX(eeefsb_backoff_mutex);
+
+static void eeefsb_backoff_routine(struct work_struct *work);
+static DECLARE_DELAYED_WORK(eeefsb_backoff_task, eeefsb_backoff_routine);
+
+/* Ceiling from the list of bad points, called with the mutex held */
+static void eeefsb_backoff_apply(void)
+{
+    int ceiling = 0;
+    int i, n;
+
+    for (i = 0; i < backoff.nr_bad; i++)
+        if (ceiling == 0 || backoff.bad[i] < ceiling)
+            ceiling = backoff.bad[i];
+    if (ceiling > 0) {
+        /* An N unit is worth about the same at either M, use the high range */
+        n = eeefsb_pll_to_n(ceiling, 50);
+        ceiling -= eeefsb_pll_to_mhz(50, n) - eeefsb_pll_to_mhz(50, n - backoff.steps);
+    }
+
+    backoff.ceiling = ceiling;
+    eeefsb_qos_update_request(&eeefsb_backoff_qos, EEEFSB_QOS_NO_MIN,
+                              ceiling > 0 ? ceiling : EEEFSB_QOS_NO_MAX);
+}
+
+/* Remember a failing point, called with the mutex held */
+static int eeefsb_backoff_mark(int mhz)
+{
+    int i;
+
+    for (i = 0; i < backoff.nr_bad; i++)
+        if (backoff.bad[i] == mhz)
+            return 0;
+    if (backoff.nr_bad == EEEFSB_BACKOFF_MAX_BAD) {
+        /* Drop the highest one, the lower ones decide the ceiling anyway */
+        int hi = 0;
+
+        for (i = 1; i < backoff.nr_bad; i++)
+            if (backoff.bad[i] > backoff.bad[hi])
+                hi = i;
+        if (backoff.bad[hi] <= mhz)
+            return 0;
+        backoff.bad[hi] = mhz;
+        return 1;
+    }
+    backoff.bad[backoff.nr_bad++] = mhz;
+
+    return 1;
+}
+
+static void eeefsb_backoff_routine(struct work_struct *work)
+{
+    unsigned long last;
+    int ramping, events, mhz;
+
+    schedule_delayed_work(&eeefsb_backoff_task, EEEFSB_BACKOFF_POLL);
+    events = atomic_xchg(&backoff_pending, 0);
+    if (events == 0)
+        return;
+
+    last = eeefsb_wq_last_change(&ramping);
+    mutex_lock(&eeefsb_backoff_mutex);
+    backoff.events += events;
+    if (!ramping && backoff.window > 0 &&
+        (last == 0 || time_after(jiffies, last + backoff.window * HZ))) {
+        printk(KERN_NOTICE "eeefsb: %i hardware error(s), not near a clock change\n",
+               events);
+        goto out;
+    }
+
+    mhz = eeefsb_get_cpu_freq();
+    if (eeefsb_backoff_mark(mhz)) {
+        eeefsb_backoff_apply();
+        printk(KERN_WARNING "eeefsb: %i hardware error(s) at %i MHz, ceiling lowered to %i MHz\n",
+               events, mhz, backoff.ceiling);
+    }
+out:
+    mutex_unlock(&eeefsb_backoff_mutex);
+}
+
+static int eeefsb_backoff_mce(struct notifier_block *nb, unsigned long val,
+                              void *data)
+{
+    atomic_inc(&backoff_pending);
+
+    return NOTIFY_DONE;
+}
+
+/* A kernel GPF is reported as DIE_GPF and then once more as DIE_OOPS */
+static int eeefsb_backoff_die(struct notifier_block *nb, unsigned long val,
+                              void *data)
+{
+    struct die_args *args = data;
+
+    if (val == DIE_GPF) {
+        this_cpu_write(backoff_gpf_regs, args->regs);
+        atomic_inc(&backoff_pending);
+    } else if (val == DIE_OOPS) {
+        if (this_cpu_read(backoff_gpf_regs) != args->regs)
+            atomic_inc(&backoff_pending);
+        this_cpu_write(backoff_gpf_regs, NULL);
+    }
+
+    return NOTIFY_DONE;
+}
+
+static struct notifier_block eeefsb_backoff_mce_nb = {
+    .notifier_call = eeefsb_backoff_mce,
+};
+
+static struct notifier_block eeefsb_backoff_die_nb = {
+    .notifier_call = eeefsb_backoff_die,
+};
+
+void eeefsb_backoff_get(struct eeefsb_backoff_state *s)
+{
+    mutex_lock(&eeefsb_backoff_mutex);
+    *s = backoff;
+    mutex_unlock(&eeefsb_backoff_mutex);
+}
+
+int eeefsb_backoff_set(int steps, int window)
+{
+    if (steps < 0 || window < 0)
+        return -EINVAL;
+
+    mutex_lock(&eeefsb_backoff_mutex);
+    backoff.steps = steps;
+    backoff.window = window;
+    eeefsb_backoff_apply();
+    mutex_unlock(&eeefsb_backoff_mutex);
+
+    return 0;
+}
+
+/* Add a failing point, e.g. one saved from an earlier boot */
+int eeefsb_backoff_add_bad(int mhz)
+{
+    if (mhz <= 0)
+        return -EINVAL;
+
+    mutex_lock(&eeefsb_backoff_mutex);
+    if (eeefsb_backoff_mark(mhz))
+        eeefsb_backoff_apply();
+    mutex_unlock(&eeefsb_backoff_mutex);
+
+    return 0;
+}
+
+void eeefsb_backoff_clear(void)
+{
+    mutex_lock(&eeefsb_backoff_mutex);
+    backoff.nr_bad = 0;
+    eeefsb_backoff_apply();
+    mutex_unlock(&eeefsb_backoff_mutex);
+}
+
+void eeefsb_backoff_init(void)
+{
+    eeefsb_qos_add_request(&eeefsb_backoff_qos, "backoff",
+                           EEEFSB_QOS_NO_MIN, EEEFSB_QOS_NO_MAX);
+    mce_register_decode_chain(&eeefsb_backoff_mce_nb);
+    register_die_notifier(&eeefsb_backoff_die_nb);
+    schedule_delayed_work(&eeefsb_backoff_task, EEEFSB_BACKOFF_POLL);
+}
+
+void eeefsb_backoff_cleanup(void)
+{
+    unregister_die_notifier(&eeefsb_backoff_die_nb);
+    mce_unregister_decode_chain(&eeefsb_backoff_mce_nb);
+    cancel_delayed_work_sync(&eeefsb_backoff_task);
+    eeefsb_qos_remove_request(&eeefsb_backoff_qos);
+}
@@ -0,0 +1,47 @@
+/*
+ *  eeefsb_backoff.h - hardware error driven clock back-off
+ *
+ *  Copyright (C) 2012 Olli Vanhoja
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  Ths program is distributed in the hope that it will be useful,
+ *  but WITOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTAILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Template Place, Suite 330, Boston, MA  02111-1307 USA
+ *  
+ *  ---------
+ *
+ *  This code comes WITHOUT ANY WARRANTY whatsoever.
+ */
+#include <linux/kernel.h>
+#include <linux/module.h>
+
+#ifndef _EEEFSB_BACKOFF_H_
+#define _EEEFSB_BACKOFF_H_
+#define EEEFSB_BACKOFF_MAX_BAD 16
+
+struct eeefsb_backoff_state
+{
+    int steps;          /* N units to back off per error */
+    int window;         /* Errors this long after a change count [s], 0 = always */
+    int ceiling;        /* Current ceiling [MHz], 0 = none */
+    int events;         /* Hardware errors seen */
+    int nr_bad;
+    int bad[EEEFSB_BACKOFF_MAX_BAD]; /* Failing operating points [MHz] */
+};
+
+void eeefsb_backoff_get(struct eeefsb_backoff_state *s);
+int eeefsb_backoff_set(int steps, int window);
+int eeefsb_backoff_add_bad(int mhz);
+void eeefsb_backoff_clear(void);
+void eeefsb_backoff_init(void);
+void eeefsb_backoff_cleanup(void);
+#endif
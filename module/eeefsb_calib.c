@@ -0,0 +1,205 @@
+/*
+ *  eeefsb_calib.c - PLL frequency self-calibration
+ *
+ *  Copyright (C) 2012 Olli Vanhoja
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  Ths program is distributed in the hope that it will be useful,
+ *  but WITOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTAILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Template Place, Suite 330, Boston, MA  02111-1307 USA
+ *  
+ *  ---------
+ *
+ *  This code comes WITHOUT ANY WARRANTY whatsoever.
+ */
+
+/*** PLL self-calibration *****************************************************
+ * The CPU PLL constant in the datasheet doesn't seem to match the chip on    *
+ * eee PC 901 (see EEEFSB_PLL_CONST_MUL in options.h), so it's measured.      *
+ *                                                                            *
+ * On Atom the TSC runs at the bus clock times the maximum core ratio, so it  *
+ * follows every FSB change. After a transition has completed the TSC is      *
+ * counted against the ACPI PM timer, which is clocked independently of the   *
+ * PLL, and the PLL constant is refitted from the result.                     *
+ *                                                                            *
+ * Once calibrated, a measurement that is more than EEEFSB_CALIB_TOLERANCE    *
+ * percent off from the expected frequency is reported as a PLL write that    *
+ * didn't take effect and is not used for fitting. If EEEFSB_CALIB_REFIT      *
+ * mismatches in a row agree on a constant among themselves, the old fit was  *
+ * the wrong one and it is replaced.                                          *
+ */
+#include <linux/kernel.h>
+#include <linux/module.h>
+#include <linux/mutex.h>
+#include <linux/workqueue.h>
+#include <linux/delay.h>
+#include <linux/irqflags.h>
+#include <linux/acpi.h>
+#include <asm/msr.h>
+#include "options.h"
+#include "pll.h"
+#include "eeefsb_calib.h"
+
+#define EEEFSB_CALIB_MSECS     100  /* Measurement window [ms] */
+#define EEEFSB_CALIB_SETTLE    (HZ / 10) /* Delay after the last PLL write */
+#define EEEFSB_CALIB_TOLERANCE 2    /* Allowed deviation once calibrated [%] */
+#define EEEFSB_CALIB_MIN_CONST 12000
+#define EEEFSB_CALIB_MAX_CONST 30000
+#define EEEFSB_CALIB_REFIT     3    /* Consistent mismatches that force a refit */
+
+static void eeefsb_calib_routine(struct work_struct *work);
+
+static DECLARE_DELAYED_WORK(eeefsb_calib_task, eeefsb_calib_routine);
+static DEFINE_MUTEX(eeefsb_calib_mutex);
+static struct eeefsb_calib_result eeefsb_calib;
+static int calib_m;
+static int calib_n;
+static int calib_dying = 0; /* Set by cleanup, no more measurements */
+static int mismatch_run = 0;   /* Consecutive mismatches agreeing on ... */
+static int mismatch_const = 0; /* ... this constant */
+
+/*
+ * Measure the TSC rate in MHz against the ACPI PM timer.
+ * Returns a negative errno if there is no PM timer.
+ */
+static int eeefsb_calib_measure(void)
+{
+    u32 pm0, pm1, usecs;
+    u64 tsc0, tsc1;
+    unsigned long flags;
+
+    local_irq_save(flags);
+    if (ACPI_FAILURE(acpi_get_timer(&pm0))) {
+        local_irq_restore(flags);
+        return -ENODEV;
+    }
+    rdtscll(tsc0);
+    local_irq_restore(flags);
+
+    msleep(EEEFSB_CALIB_MSECS);
+
+    local_irq_save(flags);
+    acpi_get_timer(&pm1);
+    rdtscll(tsc1);
+    local_irq_restore(flags);
+
+    if (ACPI_FAILURE(acpi_get_timer_duration(pm0, pm1, &usecs)) || usecs == 0)
+        return -EIO;
+
+    return (int)div_u64(tsc1 - tsc0, usecs);
+}
+
+static void eeefsb_calib_routine(struct work_struct *work)
+{
+    int measured, computed, fitted;
+    int cpuM = 0;
+    int cpuN = 0;
+    int PCID = 0;
+
+    measured = eeefsb_calib_measure();
+    if (measured <= 0) {
+        printk(KERN_DEBUG "eeefsb: calibration failed (%d)\n", measured);
+        return;
+    }
+
+    mutex_lock(&eeefsb_calib_mutex);
+    /* A new ramp may have started while we were measuring */
+    eeefsb_get_freq(&cpuM, &cpuN, &PCID);
+    if (cpuM != calib_m || cpuN != calib_n)
+        goto out;
+
+    computed = eeefsb_pll_to_mhz(calib_m, calib_n);
+    eeefsb_calib.computed = computed;
+    eeefsb_calib.measured = measured;
+
+    fitted = (measured * calib_m * 1000) / (calib_n * EEEFSB_CPU_MUL);
+    if (fitted < EEEFSB_CALIB_MIN_CONST || fitted > EEEFSB_CALIB_MAX_CONST) {
+        printk(KERN_DEBUG "eeefsb: ignoring PLL constant %i\n", fitted);
+        goto out;
+    }
+
+    if (eeefsb_calib.samples > 0 &&
+        abs(measured - computed) * 100 > computed * EEEFSB_CALIB_TOLERANCE) {
+        eeefsb_calib.mismatches++;
+        if (mismatch_run > 0 &&
+            abs(fitted - mismatch_const) * 100 <= mismatch_const * EEEFSB_CALIB_TOLERANCE)
+            mismatch_run++;
+        else
+            mismatch_run = 1;
+        mismatch_const = fitted;
+        if (mismatch_run < EEEFSB_CALIB_REFIT) {
+            printk(KERN_WARNING "eeefsb: PLL write didn't take effect? "
+                   "m = %i, n = %i should give %i MHz, measured %i MHz\n",
+                   calib_m, calib_n, computed, measured);
+            goto out;
+        }
+        /* The old fit was off, start over from this one */
+        printk(KERN_WARNING "eeefsb: %i consistent mismatches, refitting the PLL constant\n",
+               mismatch_run);
+        eeefsb_calib.samples = 0;
+    }
+    mismatch_run = 0;
+
+    /* Average in new samples so a single noisy window can't move it far */
+    if (eeefsb_calib.samples > 0)
+        fitted = (3 * eeefsb_pll_get_const() + fitted) / 4;
+    eeefsb_pll_set_const(fitted);
+    eeefsb_calib.const_milli = fitted;
+    eeefsb_calib.samples++;
+    printk(KERN_DEBUG "eeefsb: computed %i MHz, measured %i MHz, constant %i.%03i\n",
+           computed, measured, fitted / 1000, fitted % 1000);
+out:
+    mutex_unlock(&eeefsb_calib_mutex);
+}
+
+/*
+ * Schedule a measurement of the operating point the PLL was just set to.
+ */
+void eeefsb_calib_start(int cpuM, int cpuN)
+{
+    if (cpuM <= 0 || cpuN <= 0)
+        return;
+
+    cancel_delayed_work_sync(&eeefsb_calib_task);
+    mutex_lock(&eeefsb_calib_mutex);
+    calib_m = cpuM;
+    calib_n = cpuN;
+    if (!calib_dying)
+        schedule_delayed_work(&eeefsb_calib_task, EEEFSB_CALIB_SETTLE);
+    mutex_unlock(&eeefsb_calib_mutex);
+}
+
+void eeefsb_calib_get(struct eeefsb_calib_result *res)
+{
+    mutex_lock(&eeefsb_calib_mutex);
+    *res = eeefsb_calib;
+    mutex_unlock(&eeefsb_calib_mutex);
+}
+
+void eeefsb_calib_init(void)
+{
+    int cpuM = 0;
+    int cpuN = 0;
+    int PCID = 0;
+
+    eeefsb_calib.const_milli = eeefsb_pll_get_const();
+    eeefsb_get_freq(&cpuM, &cpuN, &PCID);
+    eeefsb_calib_start(cpuM, cpuN);
+}
+
+void eeefsb_calib_cleanup(void)
+{
+    mutex_lock(&eeefsb_calib_mutex);
+    calib_dying = 1;
+    mutex_unlock(&eeefsb_calib_mutex);
+    cancel_delayed_work_sync(&eeefsb_calib_task);
+}
@@ -0,0 +1,42 @@
+/*
+ *  eeefsb_calib.h - PLL frequency self-calibration
+ *
+ *  Copyright (C) 2012 Olli Vanhoja
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  Ths program is distributed in the hope that it will be useful,
+ *  but WITOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTAILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Template Place, Suite 330, Boston, MA  02111-1307 USA
+ *  
+ *  ---------
+ *
+ *  This code comes WITHOUT ANY WARRANTY whatsoever.
+ */
+#include <linux/kernel.h>
+#include <linux/module.h>
+
+#ifndef _EEEFSB_CALIB_H_
+#define _EEEFSB_CALIB_H_
+struct eeefsb_calib_result
+{
+    int computed;       /* MHz from the PLL formula before refitting */
+    int measured;       /* MHz measured from TSC against the ACPI PM timer */
+    int const_milli;    /* Current fitted PLL constant, 1/1000 units */
+    int samples;        /* Number of accepted measurements */
+    int mismatches;     /* Transitions that didn't take effect */
+};
+
+void eeefsb_calib_start(int cpuM, int cpuN);
+void eeefsb_calib_get(struct eeefsb_calib_result *res);
+void eeefsb_calib_init(void);
+void eeefsb_calib_cleanup(void);
+#endif
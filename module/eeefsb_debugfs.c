@@ -0,0 +1,215 @@
+/*
+ *  eeefsb_debugfs.c - raw register windows for eeefsb
+ *
+ *  Copyright (C) 2012 Olli Vanhoja
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  Ths program is distributed in the hope that it will be useful,
+ *  but WITOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTAILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Template Place, Suite 330, Boston, MA  02111-1307 USA
+ *  
+ *  ---------
+ *
+ *  This code comes WITHOUT ANY WARRANTY whatsoever.
+ */
+
+/*** debugfs files ************************************************************
+ * Binary files put under /sys/kernel/debug/eeefsb, both support             *
+ * pread()/pwrite() at arbitrary offsets:                                     *
+ * pll = ICS9LPR426A SMBus control block (up to 32 bytes)                     *
+ * ec  = ENE KB3310 Index IO address space (64 KB)                            *
+ *                                                                            *
+ * Raw PLL writes that touch the CPU dividers (bytes 11 and 12) go through    *
+ * eeefsb_timing_pre() / eeefsb_timing_post() like any other clock change.    *
+ *                                                                            *
+ * EC transfers are done in EEEFSB_EC_CHUNK sized batches, each one under a   *
+ * single hold of the EC mutex, so a full dump doesn't lock out the fan and   *
+ * voltage code for the whole time.                                           *
+ */
+#include <linux/kernel.h>
+#include <linux/module.h>
+#include <linux/fs.h>
+#include <linux/debugfs.h>
+#include <asm/uaccess.h>
+#include "ec.h"
+#include "pll.h"
+#include "eeefsb_timing.h"
+#include "eeefsb_debugfs.h"
+
+#define EEEFSB_EC_CHUNK 256
+
+static struct dentry *eeefsb_debugfs_dir;
+
+static ssize_t eeefsb_debugfs_pll_read(struct file *file, char __user *ubuf,
+                                       size_t count, loff_t *ppos)
+{
+    char buf[I2C_SMBUS_BLOCK_MAX];
+    int len;
+
+    if (*ppos < 0)
+        return -EINVAL;
+    if (*ppos >= I2C_SMBUS_BLOCK_MAX)
+        return 0;
+    if (count > (size_t)(I2C_SMBUS_BLOCK_MAX - *ppos))
+        count = I2C_SMBUS_BLOCK_MAX - *ppos;
+
+    len = eeefsb_pll_read_block(buf, *ppos, count);
+    if (len <= 0)
+        return len;
+    if (copy_to_user(ubuf, buf, len))
+        return -EFAULT;
+    *ppos += len;
+
+    return len;
+}
+
+static ssize_t eeefsb_debugfs_pll_write(struct file *file,
+                                        const char __user *ubuf,
+                                        size_t count, loff_t *ppos)
+{
+    char buf[I2C_SMBUS_BLOCK_MAX];
+    char next[I2C_SMBUS_BLOCK_MAX];
+    int old_m, old_n, new_m, new_n, pcid;
+    int len;
+
+    if (*ppos < 0)
+        return -EINVAL;
+    if (*ppos >= I2C_SMBUS_BLOCK_MAX)
+        return -ENOSPC;
+    if (count > (size_t)(I2C_SMBUS_BLOCK_MAX - *ppos))
+        count = I2C_SMBUS_BLOCK_MAX - *ppos;
+    if (copy_from_user(buf, ubuf, count))
+        return -EFAULT;
+
+    /* CPU dividers before and after the write, for the timing bookkeeping */
+    eeefsb_get_freq(&old_m, &old_n, &pcid);
+    new_m = old_m;
+    new_n = old_n;
+    if (eeefsb_pll_read_block(next, 0, sizeof(next)) > 12) {
+        memcpy(next + *ppos, buf, count);
+        new_m = next[11] & 0x3F;
+        new_n = ((int)(next[12] & 0xFF) << 2) | (((int)next[11] & 0xC0) >> 6);
+    }
+
+    eeefsb_timing_pre(old_m, old_n, new_m, new_n);
+    len = eeefsb_pll_write_block(buf, *ppos, count);
+    eeefsb_timing_post(old_m, old_n, new_m, new_n);
+    if (len <= 0) {
+        /* The chip didn't take it, put the bookkeeping back */
+        eeefsb_timing_pre(new_m, new_n, old_m, old_n);
+        eeefsb_timing_post(new_m, new_n, old_m, old_n);
+    }
+    if (len > 0)
+        *ppos += len;
+
+    return len;
+}
+
+static ssize_t eeefsb_debugfs_ec_read(struct file *file, char __user *ubuf,
+                                      size_t count, loff_t *ppos)
+{
+    unsigned char buf[EEEFSB_EC_CHUNK];
+    size_t done = 0;
+
+    if (*ppos < 0)
+        return -EINVAL;
+    if (*ppos >= EEEFSB_EC_SIZE)
+        return 0;
+    if (count > (size_t)(EEEFSB_EC_SIZE - *ppos))
+        count = EEEFSB_EC_SIZE - *ppos;
+
+    while (done < count) {
+        int len = min_t(size_t, count - done, EEEFSB_EC_CHUNK);
+
+        eeefsb_ec_read_block(*ppos, buf, len);
+        if (copy_to_user(ubuf + done, buf, len))
+            return done ? (ssize_t)done : -EFAULT;
+        *ppos += len;
+        done += len;
+    }
+
+    return done;
+}
+
+static ssize_t eeefsb_debugfs_ec_write(struct file *file,
+                                       const char __user *ubuf,
+                                       size_t count, loff_t *ppos)
+{
+    unsigned char buf[EEEFSB_EC_CHUNK];
+    size_t done = 0;
+
+    if (*ppos < 0)
+        return -EINVAL;
+    if (*ppos >= EEEFSB_EC_SIZE)
+        return -ENOSPC;
+    if (count > (size_t)(EEEFSB_EC_SIZE - *ppos))
+        count = EEEFSB_EC_SIZE - *ppos;
+
+    while (done < count) {
+        int len = min_t(size_t, count - done, EEEFSB_EC_CHUNK);
+
+        if (copy_from_user(buf, ubuf + done, len))
+            return done ? (ssize_t)done : -EFAULT;
+        eeefsb_ec_write_block(*ppos, buf, len);
+        *ppos += len;
+        done += len;
+    }
+
+    return done;
+}
+
+static const struct file_operations eeefsb_debugfs_pll_fops = {
+    .owner  = THIS_MODULE,
+    .read   = eeefsb_debugfs_pll_read,
+    .write  = eeefsb_debugfs_pll_write,
+    .llseek = default_llseek,
+};
+
+static const struct file_operations eeefsb_debugfs_ec_fops = {
+    .owner  = THIS_MODULE,
+    .read   = eeefsb_debugfs_ec_read,
+    .write  = eeefsb_debugfs_ec_write,
+    .llseek = default_llseek,
+};
+
+struct dentry *eeefsb_debugfs_root(void)
+{
+    return eeefsb_debugfs_dir;
+}
+
+int eeefsb_debugfs_init(void)
+{
+    eeefsb_debugfs_dir = debugfs_create_dir("eeefsb", NULL);
+    if (IS_ERR_OR_NULL(eeefsb_debugfs_dir)) {
+        printk(KERN_ERR "eeefsb: Unable to create debugfs directory\n");
+        eeefsb_debugfs_dir = NULL;
+        return -ENODEV;
+    }
+
+    if (!debugfs_create_file("pll", 0600, eeefsb_debugfs_dir, NULL,
+                             &eeefsb_debugfs_pll_fops) ||
+        !debugfs_create_file("ec", 0600, eeefsb_debugfs_dir, NULL,
+                             &eeefsb_debugfs_ec_fops)) {
+        printk(KERN_ERR "eeefsb: Unable to create debugfs files\n");
+        debugfs_remove_recursive(eeefsb_debugfs_dir);
+        eeefsb_debugfs_dir = NULL;
+        return -ENODEV;
+    }
+
+    return 0;
+}
+
+void eeefsb_debugfs_cleanup(void)
+{
+    debugfs_remove_recursive(eeefsb_debugfs_dir);
+    eeefsb_debugfs_dir = NULL;
+}
@@ -0,0 +1,305 @@
+/*
+ *  eeefsb_loadgov.c - ramp cost aware predictive load governor
+ *
+ *  Copyright (C) 2012 Olli Vanhoja
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  Ths program is distributed in the hope that it will be useful,
+ *  but WITOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTAILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Template Place, Suite 330, Boston, MA  02111-1307 USA
+ *  
+ *  ---------
+ *
+ *  This code comes WITHOUT ANY WARRANTY whatsoever.
+ */
+
+/*** Predictive load governor *************************************************
+ * A full ramp takes seconds, so reacting to every load spike would start     *
+ * ramps for loads that are gone before the clock gets there. Every           *
+ * EEEFSB_LOADGOV_PERIOD this governor                                        *
+ *  - takes the idle time delta of every logical CPU and uses the busiest     *
+ *    one, both hyperthreads share the core and the clock                     *
+ *  - keeps an EWMA of the utilization (alpha % new sample) as the predicted  *
+ *    load, and EWMAs of how long busy (>= up_pct) and idle (< down_pct)      *
+ *    phases last                                                             *
+ *  - once the prediction crosses a threshold and the last retarget is at     *
+ *    least dwell ms old, asks the stepper how long the ramp would take and   *
+ *    expects the phase to last another max(average - elapsed, elapsed) ms    *
+ *  - ramps only if the share of that time run at the new clock is worth      *
+ *    more than cost_pct % of the ramp time:                                  *
+ *      (remaining - ramp / 2) * |new - old| / max(new, old)                  *
+ *          > ramp * cost_pct / 100                                           *
+ * Busy phases go to the top clock (the QoS ceiling still applies), idle      *
+ * ones down in proportion to the load. The old clock is the one the stepper  *
+ * last wrote, and the target stands in for the cpu_freq request while        *
+ * enabled, see eeefsb_wq_set_governor().                                     *
+ * Enabling it turns the memory stall governor off and vice versa, both under *
+ * eeefsb_gov_mutex.                                                          *
+ */
+#include <linux/kernel.h>
+#include <linux/module.h>
+#include <linux/mutex.h>
+#include <linux/workqueue.h>
+#include <linux/percpu.h>
+#include <linux/cpu.h>
+#include <linux/jiffies.h>
+#include <linux/tick.h>
+#include <linux/kernel_stat.h>
+#include "options.h"
+#include "pll.h"
+#include "eeefsb_plan.h"
+#include "eeefsb_wq.h"
+#include "eeefsb_memgov.h"
+#include "eeefsb_loadgov.h"
+
+#define EEEFSB_LOADGOV_PERIOD (HZ / 4) /* Sampling period [jiffy] */
+#define EEEFSB_LOADGOV_SHIFT  8        /* Fixed point fraction of the averages */
+#define EEEFSB_LOADGOV_MAX_PHASE 600000 /* Longer phases count as this [ms] */
+
+struct eeefsb_loadgov_cpu
+{
+    u64 idle;           /* [us] */
+    u64 wall;           /* [us] */
+};
+
+static DEFINE_PER_CPU(struct eeefsb_loadgov_cpu, eeefsb_loadgov_cpus);
+static DEFINE_MUTEX(eeefsb_loadgov_mutex);
+/* Serializes enabling either governor, so only one can end up running */
+DEFINE_MUTEX(eeefsb_gov_mutex);
+
+static struct eeefsb_loadgov_tunables loadgov = {
+    .enabled  = 0,
+    .up_pct   = EEEFSB_LOADGOV_UP,
+    .down_pct = EEEFSB_LOADGOV_DOWN,
+    .alpha    = 30,
+    .cost_pct = 200,
+    .dwell    = EEEFSB_LOADGOV_DWELL,
+};
+static struct eeefsb_loadgov_stats loadgov_stats;
+static int avg_fp;                  /* Averages in 1/256 units, so */
+static int burst_fp;                /* small steps don't truncate to */
+static int lull_fp;                 /* nothing and stall the average */
+static int phase_ms;                /* Time in the current phase */
+static int phase_busy;              /* 1 busy, 0 idle, -1 in between */
+static unsigned long last_retarget; /* jiffies */
+
+static void eeefsb_loadgov_routine(struct work_struct *work);
+static DECLARE_DELAYED_WORK(eeefsb_loadgov_task, eeefsb_loadgov_routine);
+
+/* Idle and wall time of a CPU [us], iowait counts as idle */
+static void eeefsb_loadgov_times(int cpu, u64 *idle, u64 *wall)
+{
+    u64 iowait;
+
+    *idle = get_cpu_idle_time_us(cpu, wall);
+    if (*idle != -1ULL)
+    {
+        iowait = get_cpu_iowait_time_us(cpu, NULL);
+        if (iowait != -1ULL)
+            *idle += iowait;
+        return;
+    }
+
+    /* No NOHZ idle accounting, fall back to the tick based statistics */
+    *idle = kcpustat_cpu(cpu).cpustat[CPUTIME_IDLE] +
+            kcpustat_cpu(cpu).cpustat[CPUTIME_IOWAIT];
+    *idle = cputime64_to_jiffies64(*idle) * (USEC_PER_SEC / HZ);
+    *wall = get_jiffies_64() * (USEC_PER_SEC / HZ);
+}
+
+/* Utilization of the busiest CPU since the last call [%] */
+static int eeefsb_loadgov_sample(void)
+{
+    u64 idle, wall, d_idle, d_wall;
+    int cpu, util, max = 0;
+
+    for_each_online_cpu(cpu) {
+        struct eeefsb_loadgov_cpu *c = &per_cpu(eeefsb_loadgov_cpus, cpu);
+
+        eeefsb_loadgov_times(cpu, &idle, &wall);
+        d_idle = idle - c->idle;
+        d_wall = wall - c->wall;
+        c->idle = idle;
+        c->wall = wall;
+        if (d_wall == 0 || d_idle > d_wall)
+            continue;
+        util = (int)div64_u64((d_wall - d_idle) * 100, d_wall);
+        if (util > max)
+            max = util;
+    }
+
+    return max;
+}
+
+/* Move a fixed point average towards sample by alpha % */
+static int eeefsb_loadgov_ewma(int *fp, int sample)
+{
+    if (sample > EEEFSB_LOADGOV_MAX_PHASE)
+        sample = EEEFSB_LOADGOV_MAX_PHASE;
+    *fp += (int)div_s64(((s64)(sample << EEEFSB_LOADGOV_SHIFT) - *fp) *
+                        loadgov.alpha, 100);
+
+    return (*fp + (1 << (EEEFSB_LOADGOV_SHIFT - 1))) >> EEEFSB_LOADGOV_SHIFT;
+}
+
+/* Does a ramp from cur to target pay off if the phase lasts remaining ms */
+static int eeefsb_loadgov_worth(int cur, int target, int remaining)
+{
+    int ramp, hi;
+    s64 benefit, cost;
+
+    ramp = eeefsb_wq_ramp_estimate(target);
+    loadgov_stats.ramp_ms = ramp;
+    if (ramp < 0)
+        return 0; /* The stepper can't plan it either */
+    if (ramp == 0)
+        return 1; /* A single write or nothing to plan, always worth it */
+    hi = (target > cur) ? target : cur;
+
+    benefit = (s64)(remaining - ramp / 2) * abs(target - cur);
+    cost = (s64)ramp * loadgov.cost_pct * hi / 100;
+
+    return benefit > cost;
+}
+
+static void eeefsb_loadgov_routine(struct work_struct *work)
+{
+    int period_ms = jiffies_to_msecs(EEEFSB_LOADGOV_PERIOD);
+    int util, busy, cur, target, elapsed, avg_len, remaining;
+    int f_min, f_max;
+
+    mutex_lock(&eeefsb_loadgov_mutex);
+    if (!loadgov.enabled) {
+        mutex_unlock(&eeefsb_loadgov_mutex);
+        return;
+    }
+
+    util = eeefsb_loadgov_sample();
+    loadgov_stats.util = util;
+    loadgov_stats.avg = eeefsb_loadgov_ewma(&avg_fp, util);
+
+    /* Phase lengths, a phase ends when the raw load leaves its band */
+    busy = (util >= loadgov.up_pct) ? 1 : (util < loadgov.down_pct) ? 0 : -1;
+    if (busy == phase_busy) {
+        phase_ms += period_ms;
+    } else {
+        if (phase_busy == 1)
+            loadgov_stats.burst_ms = eeefsb_loadgov_ewma(&burst_fp, phase_ms);
+        else if (phase_busy == 0)
+            loadgov_stats.lull_ms = eeefsb_loadgov_ewma(&lull_fp, phase_ms);
+        phase_busy = busy;
+        phase_ms = period_ms;
+    }
+
+    if (time_before(jiffies, last_retarget + msecs_to_jiffies(loadgov.dwell)))
+        goto out;
+
+    f_min = eeefsb_pll_to_mhz(50, eeefsb_plan_n_min(50));
+    f_max = eeefsb_pll_to_mhz(49, eeefsb_plan_n_max(49));
+    cur = eeefsb_wq_get_current();
+    if (avg_fp >= (loadgov.up_pct << EEEFSB_LOADGOV_SHIFT) && cur < f_max) {
+        target = f_max;
+        avg_len = loadgov_stats.burst_ms;
+    } else if (avg_fp < (loadgov.down_pct << EEEFSB_LOADGOV_SHIFT) && cur > f_min) {
+        /* Enough clock to bring the load up to the middle of the band */
+        target = (int)div_s64((s64)cur * avg_fp * 2,
+                              (loadgov.up_pct + loadgov.down_pct) << EEEFSB_LOADGOV_SHIFT);
+        if (target < f_min)
+            target = f_min;
+        avg_len = loadgov_stats.lull_ms;
+    } else {
+        goto out;
+    }
+    if (target == cur || target == loadgov_stats.target)
+        goto out; /* There or on the way */
+
+    elapsed = (phase_busy == (target > cur)) ? phase_ms : 0;
+    remaining = (avg_len - elapsed > elapsed) ? avg_len - elapsed : elapsed;
+    if (!eeefsb_loadgov_worth(cur, target, remaining)) {
+        loadgov_stats.skipped++;
+        goto out;
+    }
+
+    loadgov_stats.target = target;
+    last_retarget = jiffies;
+    printk(KERN_DEBUG "eeefsb: loadgov load %i%%, phase %i of %i ms, ramp %i ms, target %i MHz\n",
+           loadgov_stats.avg, elapsed, avg_len, loadgov_stats.ramp_ms, target);
+    eeefsb_wq_set_governor(target);
+
+out:
+    schedule_delayed_work(&eeefsb_loadgov_task, EEEFSB_LOADGOV_PERIOD);
+    mutex_unlock(&eeefsb_loadgov_mutex);
+}
+
+int eeefsb_loadgov_set(const struct eeefsb_loadgov_tunables *t)
+{
+    int cpu;
+
+    if (t->up_pct <= t->down_pct || t->up_pct > 100 || t->down_pct < 0 ||
+        t->alpha <= 0 || t->alpha > 100 || t->cost_pct < 0 || t->dwell < 0)
+        return -EINVAL;
+
+    /* Only one governor at a time, before taking our mutex */
+    mutex_lock(&eeefsb_gov_mutex);
+    if (t->enabled)
+        eeefsb_memgov_disable();
+
+    cancel_delayed_work_sync(&eeefsb_loadgov_task);
+    mutex_lock(&eeefsb_loadgov_mutex);
+    if (t->enabled && !loadgov.enabled) {
+        memset(&loadgov_stats, 0, sizeof(loadgov_stats));
+        avg_fp = burst_fp = lull_fp = 0;
+        phase_busy = -1;
+        phase_ms = 0;
+        last_retarget = jiffies;
+        for_each_possible_cpu(cpu) {
+            struct eeefsb_loadgov_cpu *c = &per_cpu(eeefsb_loadgov_cpus, cpu);
+
+            eeefsb_loadgov_times(cpu, &c->idle, &c->wall);
+        }
+    } else if (!t->enabled && loadgov.enabled) {
+        eeefsb_wq_set_governor(0);
+    }
+    loadgov = *t;
+    loadgov.enabled = t->enabled ? 1 : 0;
+    if (loadgov.enabled)
+        schedule_delayed_work(&eeefsb_loadgov_task, EEEFSB_LOADGOV_PERIOD);
+    mutex_unlock(&eeefsb_loadgov_mutex);
+    mutex_unlock(&eeefsb_gov_mutex);
+
+    return 0;
+}
+
+void eeefsb_loadgov_get(struct eeefsb_loadgov_tunables *t,
+                        struct eeefsb_loadgov_stats *s)
+{
+    mutex_lock(&eeefsb_loadgov_mutex);
+    *t = loadgov;
+    *s = loadgov_stats;
+    mutex_unlock(&eeefsb_loadgov_mutex);
+}
+
+/* Stop governing, the clock goes back to the user's request */
+void eeefsb_loadgov_disable(void)
+{
+    cancel_delayed_work_sync(&eeefsb_loadgov_task);
+    mutex_lock(&eeefsb_loadgov_mutex);
+    if (loadgov.enabled)
+        eeefsb_wq_set_governor(0);
+    loadgov.enabled = 0;
+    mutex_unlock(&eeefsb_loadgov_mutex);
+}
+
+void eeefsb_loadgov_cleanup(void)
+{
+    eeefsb_loadgov_disable();
+}
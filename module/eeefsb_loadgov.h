@@ -0,0 +1,57 @@
+/*
+ *  eeefsb_loadgov.h - ramp cost aware predictive load governor
+ *
+ *  Copyright (C) 2012 Olli Vanhoja
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  Ths program is distributed in the hope that it will be useful,
+ *  but WITOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTAILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Template Place, Suite 330, Boston, MA  02111-1307 USA
+ *  
+ *  ---------
+ *
+ *  This code comes WITHOUT ANY WARRANTY whatsoever.
+ */
+#include <linux/kernel.h>
+#include <linux/module.h>
+
+#ifndef _EEEFSB_LOADGOV_H_
+#define _EEEFSB_LOADGOV_H_
+struct eeefsb_loadgov_tunables
+{
+    int enabled;
+    int up_pct;         /* Predicted utilization to ramp up at */
+    int down_pct;       /* Predicted utilization to ramp down at */
+    int alpha;          /* Weight of a new sample in the averages [%] */
+    int cost_pct;       /* Weight of the ramp time against the benefit [%] */
+    int dwell;          /* Minimum time between retargets [ms] */
+};
+
+struct eeefsb_loadgov_stats
+{
+    int util;           /* Busiest CPU in the last period [%] */
+    int avg;            /* Predicted utilization [%] */
+    int burst_ms;       /* Average length of a busy phase */
+    int lull_ms;        /* Average length of an idle phase */
+    int ramp_ms;        /* Estimated time of the last ramp considered */
+    int target;         /* [MHz] */
+    int skipped;        /* Ramps not taken because they wouldn't pay off */
+};
+
+extern struct mutex eeefsb_gov_mutex;
+
+int eeefsb_loadgov_set(const struct eeefsb_loadgov_tunables *t);
+void eeefsb_loadgov_get(struct eeefsb_loadgov_tunables *t,
+                        struct eeefsb_loadgov_stats *s);
+void eeefsb_loadgov_disable(void);
+void eeefsb_loadgov_cleanup(void);
+#endif
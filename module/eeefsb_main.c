@@ -30,11 +30,22 @@
 #include <linux/kernel.h>
 #include <linux/module.h>
 #include <linux/proc_fs.h>      /* Necessary because we use the proc fs */
+#include <linux/slab.h>
 #include <asm/uaccess.h> 
 #include "options.h"            /* FSB tuning options */
 #include "ec.h"
 #include "pll.h"
 #include "eeefsb_wq.h"
+#include "eeefsb_debugfs.h"
+#include "eeefsb_calib.h"
+#include "eeefsb_memgov.h"
+#include "eeefsb_loadgov.h"
+#include "eeefsb_power.h"
+#include "eeefsb_thermal.h"
+#include "eeefsb_trace.h"
+#include "eeefsb_qos.h"
+#include "eeefsb_backoff.h"
+#include "eeefsb_timing.h"
 
 /*
  * Module info
@@ -53,6 +64,15 @@ MODULE_INFO(module_depends, "i2c-i801");
  * fan_speed   =                                                              *
  * fan_rpm     =                                                              *
  * fan_control =                                                              *
+ * ramp_plan   = Remaining waypoints of the current cpu_freq ramp             *
+ * clocks      = PLL clock output and spread spectrum enables                 *
+ * calibration = Computed vs. measured CPU clock and fitted PLL constant      *
+ * memgov      = Memory stall driven governor tunables and state              *
+ * loadgov     = Predictive load governor tunables and state                  *
+ * power_policy = Clock, voltage and fan policy per power source              *
+ * thermal     = Emergency thermal watchdog trip points and state             *
+ * qos         = Active CPU clock constraints, see eeefsb_qos.c               *
+ * backoff     = Hardware error back-off settings and failing clocks          *
  */
 static struct proc_dir_entry *eeefsb_proc_rootdir;
 #define EEEFSB_PROC_READFUNC(NAME) \
@@ -115,9 +135,13 @@ EEEFSB_PROC_WRITEFUNC(bus_control)
     int cpuN = 420;
     int PCID = 15;
     int voltage = 1;
+    int oldM = 0, oldN = 0, oldPCID = 0;
 
     EEEFSB_PROC_SCANF(4, "%i %i %i %i", &cpuM, &cpuN, &PCID, &voltage);
+    eeefsb_get_freq(&oldM, &oldN, &oldPCID);
+    eeefsb_timing_pre(oldM, oldN, cpuM, cpuN);
     eeefsb_set_freq(cpuM, cpuN, PCID);
+    eeefsb_timing_post(oldM, oldN, cpuM, cpuN);
     eeefsb_set_voltage(voltage);
 }
 
@@ -138,11 +162,220 @@ EEEFSB_PROC_WRITEFUNC(cpu_freq)
     eeefsb_wq_start(cpuFreq);
 }
 
-/*EEEFSB_PROC_READFUNC(pll)
+EEEFSB_PROC_READFUNC(calibration)
 {
-    eeefsb_pll_read();
-    EEEFSB_PROC_MEMCPY(eeefsb_pll_data, eeefsb_pll_datalen);
-}*/
+    struct eeefsb_calib_result res;
+
+    eeefsb_calib_get(&res);
+    EEEFSB_PROC_PRINTF("%d %d %d.%03d %d %d\n", res.computed, res.measured,
+                       res.const_milli / 1000, res.const_milli % 1000,
+                       res.samples, res.mismatches);
+}
+
+EEEFSB_PROC_READFUNC(memgov)
+{
+    struct eeefsb_memgov_tunables t;
+    struct eeefsb_memgov_stats st;
+
+    eeefsb_memgov_get(&t, &st);
+    EEEFSB_PROC_PRINTF("%d %d %d %d %d %d\n", t.enabled, t.w_busy, t.w_mem,
+                       t.mpki_full, t.idle_pct, t.hyst);
+    EEEFSB_PROC_PRINTF("# busy %d%% mpki %d.%d score %d target %d\n",
+                       st.busy_pct, st.mpki10 / 10, st.mpki10 % 10,
+                       st.score, st.target);
+}
+
+EEEFSB_PROC_WRITEFUNC(memgov)
+{
+    struct eeefsb_memgov_tunables t;
+    struct eeefsb_memgov_stats st;
+
+    eeefsb_memgov_get(&t, &st);
+    EEEFSB_PROC_SCANF(1, "%i %i %i %i %i %i", &t.enabled, &t.w_busy, &t.w_mem,
+                      &t.mpki_full, &t.idle_pct, &t.hyst);
+    if (eeefsb_memgov_set(&t))
+        printk(KERN_DEBUG "eeefsb: Invalid memgov settings\n");
+}
+
+EEEFSB_PROC_READFUNC(loadgov)
+{
+    struct eeefsb_loadgov_tunables t;
+    struct eeefsb_loadgov_stats st;
+
+    eeefsb_loadgov_get(&t, &st);
+    EEEFSB_PROC_PRINTF("%d %d %d %d %d %d\n", t.enabled, t.up_pct, t.down_pct,
+                       t.alpha, t.cost_pct, t.dwell);
+    EEEFSB_PROC_PRINTF("# util %d%% avg %d%% burst %d ms lull %d ms ramp %d ms target %d skipped %d\n",
+                       st.util, st.avg, st.burst_ms, st.lull_ms, st.ramp_ms,
+                       st.target, st.skipped);
+}
+
+EEEFSB_PROC_WRITEFUNC(loadgov)
+{
+    struct eeefsb_loadgov_tunables t;
+    struct eeefsb_loadgov_stats st;
+
+    eeefsb_loadgov_get(&t, &st);
+    EEEFSB_PROC_SCANF(1, "%i %i %i %i %i %i", &t.enabled, &t.up_pct, &t.down_pct,
+                      &t.alpha, &t.cost_pct, &t.dwell);
+    if (eeefsb_loadgov_set(&t))
+        printk(KERN_DEBUG "eeefsb: Invalid loadgov settings\n");
+}
+
+EEEFSB_PROC_READFUNC(power_policy)
+{
+    struct eeefsb_power_policy p;
+    int i;
+
+    for (i = 0; i < EEEFSB_POWER_NR_SOURCES; i++)
+    {
+        eeefsb_power_get_policy(i, &p);
+        EEEFSB_PROC_PRINTF("%s %d %d %d %d\n", eeefsb_power_source_name(i),
+                           p.min, p.max, p.low_voltage, p.fan);
+    }
+    EEEFSB_PROC_PRINTF("lowbat_capacity %d\n", eeefsb_power_get_lowbat());
+    EEEFSB_PROC_PRINTF("# source %s capacity %d\n",
+                       eeefsb_power_source_name(eeefsb_power_get_source()),
+                       eeefsb_power_get_capacity());
+}
+
+EEEFSB_PROC_WRITEFUNC(power_policy)
+{
+    struct eeefsb_power_policy p;
+    char name[16];
+    int source;
+
+    EEEFSB_PROC_SCANF(1, "%15s", name);
+    if (strcmp(name, "lowbat_capacity") == 0)
+    {
+        int capacity = 0;
+
+        EEEFSB_PROC_SCANF(1, "%i", &capacity);
+        if (eeefsb_power_set_lowbat(capacity))
+            printk(KERN_DEBUG "eeefsb: Invalid low battery capacity %d\n", capacity);
+        return;
+    }
+
+    source = eeefsb_power_source_lookup(name);
+    if (source < 0)
+    {
+        printk(KERN_DEBUG "eeefsb: Unknown power source %s\n", name);
+        return;
+    }
+    eeefsb_power_get_policy(source, &p);
+    EEEFSB_PROC_SCANF(2, "%i %i %i %i", &p.min, &p.max, &p.low_voltage, &p.fan);
+    if (eeefsb_power_set_policy(source, &p))
+        printk(KERN_DEBUG "eeefsb: Invalid policy for %s\n", name);
+}
+
+EEEFSB_PROC_READFUNC(thermal)
+{
+    struct eeefsb_thermal_tunables t;
+    struct eeefsb_thermal_state st;
+
+    eeefsb_thermal_get(&t, &st);
+    EEEFSB_PROC_PRINTF("%d %d %d %d\n", t.limit, t.slope, t.stall, t.hyst);
+    EEEFSB_PROC_PRINTF("# tripped %d trips %d temperature %u rpm %u\n",
+                       st.tripped, st.trips, st.temperature, st.rpm);
+}
+
+EEEFSB_PROC_WRITEFUNC(thermal)
+{
+    struct eeefsb_thermal_tunables t;
+    struct eeefsb_thermal_state st;
+
+    eeefsb_thermal_get(&t, &st);
+    EEEFSB_PROC_SCANF(1, "%i %i %i %i", &t.limit, &t.slope, &t.stall, &t.hyst);
+    if (eeefsb_thermal_set(&t))
+        printk(KERN_DEBUG "eeefsb: Invalid thermal settings\n");
+}
+
+EEEFSB_PROC_READFUNC(qos)
+{
+    *bufpos += eeefsb_qos_show(buf + *bufpos, buflen - *bufpos);
+}
+
+EEEFSB_PROC_READFUNC(backoff)
+{
+    struct eeefsb_backoff_state st;
+    int i;
+
+    eeefsb_backoff_get(&st);
+    EEEFSB_PROC_PRINTF("%d %d\n", st.steps, st.window);
+    for (i = 0; i < st.nr_bad; i++)
+    {
+        EEEFSB_PROC_PRINTF("bad %d\n", st.bad[i]);
+    }
+    EEEFSB_PROC_PRINTF("# ceiling %d events %d\n", st.ceiling, st.events);
+}
+
+EEEFSB_PROC_WRITEFUNC(backoff)
+{
+    struct eeefsb_backoff_state st;
+    char cmd[8] = "";
+    int mhz = 0;
+
+    sscanf(buf + *bufpos, "%7s", cmd);
+    if (strcmp(cmd, "clear") == 0)
+    {
+        eeefsb_backoff_clear();
+        return;
+    }
+    if (strcmp(cmd, "bad") == 0)
+    {
+        EEEFSB_PROC_SCANF(1, "%7s %i", cmd, &mhz);
+        if (eeefsb_backoff_add_bad(mhz))
+            printk(KERN_DEBUG "eeefsb: Invalid failing clock %d\n", mhz);
+        return;
+    }
+
+    eeefsb_backoff_get(&st);
+    EEEFSB_PROC_SCANF(1, "%i %i", &st.steps, &st.window);
+    if (eeefsb_backoff_set(st.steps, st.window))
+        printk(KERN_DEBUG "eeefsb: Invalid backoff settings\n");
+}
+
+EEEFSB_PROC_READFUNC(ramp_plan)
+{
+    struct eeefsb_plan *plan;
+    int pos, i;
+
+    plan = kmalloc(sizeof(*plan), GFP_KERNEL);
+    if (!plan)
+        return;
+
+    pos = eeefsb_wq_get_plan(plan);
+    EEEFSB_PROC_PRINTF("# step m n pcid voltage (%d of %d done)\n", pos, plan->len);
+    /* Leave room for one more line, snprintf() doesn't stop bufpos growing */
+    for (i = pos; i < plan->len && *bufpos < buflen - 64; i++)
+    {
+        EEEFSB_PROC_PRINTF("%d %d %d %d %d\n", i, plan->wp[i].m, plan->wp[i].n,
+                           plan->wp[i].pcid, plan->wp[i].voltage);
+    }
+    kfree(plan);
+}
+
+EEEFSB_PROC_READFUNC(clocks)
+{
+    int i;
+
+    for (i = 0; i < eeefsb_pll_clk_count(); i++)
+    {
+        EEEFSB_PROC_PRINTF("%s %d\n", eeefsb_pll_clk_name(i), eeefsb_pll_clk_get(i));
+    }
+}
+
+EEEFSB_PROC_WRITEFUNC(clocks)
+{
+    char name[16];
+    int enable = 1;
+    int id;
+
+    EEEFSB_PROC_SCANF(2, "%15s %i", name, &enable);
+    id = eeefsb_pll_clk_lookup(name);
+    if (id < 0 || eeefsb_pll_clk_set(id, enable))
+        printk(KERN_DEBUG "eeefsb: Unable to set clock %s\n", name);
+}
 
 EEEFSB_PROC_READFUNC(fan_speed)
 {
@@ -183,8 +416,16 @@ EEEFSB_PROC_READFUNC(temperature)
 
 EEEFSB_PROC_FILES_BEGIN
     EEEFSB_PROC_RW(bus_control,    0644),
-    /*EEEFSB_PROC_RO(pll,            0400),*/
     EEEFSB_PROC_RW(cpu_freq,       0644),
+    EEEFSB_PROC_RO(ramp_plan,      0444),
+    EEEFSB_PROC_RO(calibration,    0444),
+    EEEFSB_PROC_RW(memgov,         0644),
+    EEEFSB_PROC_RW(loadgov,        0644),
+    EEEFSB_PROC_RW(power_policy,   0644),
+    EEEFSB_PROC_RW(thermal,        0644),
+    EEEFSB_PROC_RO(qos,            0444),
+    EEEFSB_PROC_RW(backoff,        0644),
+    EEEFSB_PROC_RW(clocks,         0644),
     EEEFSB_PROC_RW(fan_speed,      0644),
     EEEFSB_PROC_RO(fan_rpm,        0444),
     EEEFSB_PROC_RW(fan_control,    0644),
@@ -296,8 +537,17 @@ static int __init eeefsb_init(void)
     
     retVal = eeefsb_pll_init();
     if (retVal) return retVal;
+    eeefsb_timing_init(); /* Before anything can change the clock */
     eeefsb_proc_init();
+    eeefsb_debugfs_init(); /* Optional, raw register windows only */
+    eeefsb_trace_init();
     eeefsb_wq_init();
+    eeefsb_calib_init();
+    eeefsb_qos_init(); /* Optional, /dev/eeefsb_qos only */
+    eeefsb_memgov_init();
+    eeefsb_power_init();
+    eeefsb_thermal_init();
+    eeefsb_backoff_init();
     printk(KERN_NOTICE "eee PC CPU speed control tool, version %s\n",
            EEEFSB_VERSION);
     
@@ -306,9 +556,19 @@ static int __init eeefsb_init(void)
 
 static void __exit eeefsb_exit(void)
 {
-    eeefsb_pll_cleanup();
+    eeefsb_backoff_cleanup();
+    eeefsb_thermal_cleanup();
+    eeefsb_power_cleanup();
+    eeefsb_qos_cleanup();
+    eeefsb_loadgov_cleanup();
+    eeefsb_memgov_cleanup();
+    eeefsb_debugfs_cleanup();
     eeefsb_proc_cleanup();
+    /* The stepper starts calibrations and writes the PLL, stop it first */
     eeefsb_wq_cleanup();
+    eeefsb_calib_cleanup();
+    eeefsb_pll_cleanup();
+    eeefsb_trace_cleanup();
     printk(KERN_INFO "/proc/eeefsb removed\n");
 }
 
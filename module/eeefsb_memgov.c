@@ -0,0 +1,336 @@
+/*
+ *  eeefsb_memgov.c - memory stall driven FSB governor
+ *
+ *  Copyright (C) 2012 Olli Vanhoja
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  Ths program is distributed in the hope that it will be useful,
+ *  but WITOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTAILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Template Place, Suite 330, Boston, MA  02111-1307 USA
+ *  
+ *  ---------
+ *
+ *  This code comes WITHOUT ANY WARRANTY whatsoever.
+ */
+
+/*** Memory stall driven FSB governor *****************************************
+ * Raising the FSB raises memory bandwidth too, not just the core clock, so   *
+ * the workloads that benefit most are the memory bound ones. This governor   *
+ * samples in-kernel perf counters on every logical CPU:                      *
+ *   cycles       - unhalted core cycles, compared to the TSC for utilization *
+ *   instructions - retired instructions                                      *
+ *   cache-misses - last level cache misses, i.e. trips to memory             *
+ *                                                                            *
+ * Every EEEFSB_MEMGOV_PERIOD it computes a score from 0 to 100:              *
+ *   score = (w_busy * busy% + w_mem * min(MPKI / mpki_full, 1) * 100)        *
+ *           / (w_busy + w_mem)                                               *
+ * and maps it linearly onto the valid frequency range. Below idle_pct the    *
+ * lowest clock is used. The stepper is only retargeted if the new target     *
+ * differs by more than hyst MHz from the last one. The target stands in for  *
+ * the cpu_freq request while enabled, see eeefsb_wq_set_governor().          *
+ * Enabling it turns the predictive load governor off.                        *
+ */
+#include <linux/kernel.h>
+#include <linux/module.h>
+#include <linux/mutex.h>
+#include <linux/workqueue.h>
+#include <linux/percpu.h>
+#include <linux/cpu.h>
+#include <linux/perf_event.h>
+#include <asm/msr.h>
+#include "options.h"
+#include "pll.h"
+#include "eeefsb_plan.h"
+#include "eeefsb_wq.h"
+#include "eeefsb_memgov.h"
+#include "eeefsb_loadgov.h"
+
+#define EEEFSB_MEMGOV_PERIOD HZ /* Sampling period [jiffy] */
+
+enum {
+    MEMGOV_CYCLES,
+    MEMGOV_INSTR,
+    MEMGOV_MISSES,
+    MEMGOV_NR_EVENTS
+};
+
+static const u64 eeefsb_memgov_config[MEMGOV_NR_EVENTS] = {
+    PERF_COUNT_HW_CPU_CYCLES,
+    PERF_COUNT_HW_INSTRUCTIONS,
+    PERF_COUNT_HW_CACHE_MISSES,
+};
+
+struct eeefsb_memgov_cpu
+{
+    struct perf_event *event[MEMGOV_NR_EVENTS];
+    u64 last[MEMGOV_NR_EVENTS];
+};
+
+static DEFINE_PER_CPU(struct eeefsb_memgov_cpu, eeefsb_memgov_cpus);
+static DEFINE_MUTEX(eeefsb_memgov_mutex);
+
+static struct eeefsb_memgov_tunables memgov = {
+    .enabled   = 0,
+    .w_busy    = 1,
+    .w_mem     = 3,
+    .mpki_full = 100,
+    .idle_pct  = 10,
+    .hyst      = 50,
+};
+static struct eeefsb_memgov_stats memgov_stats;
+static u64 memgov_last_tsc;
+
+static void eeefsb_memgov_routine(struct work_struct *work);
+static DECLARE_DELAYED_WORK(eeefsb_memgov_task, eeefsb_memgov_routine);
+
+static void eeefsb_memgov_release_cpu(int cpu)
+{
+    struct eeefsb_memgov_cpu *c = &per_cpu(eeefsb_memgov_cpus, cpu);
+    int i;
+
+    for (i = 0; i < MEMGOV_NR_EVENTS; i++) {
+        if (c->event[i])
+            perf_event_release_kernel(c->event[i]);
+        c->event[i] = NULL;
+        c->last[i] = 0;
+    }
+}
+
+static void eeefsb_memgov_release(void)
+{
+    int cpu;
+
+    for_each_possible_cpu(cpu)
+        eeefsb_memgov_release_cpu(cpu);
+}
+
+static int eeefsb_memgov_create_cpu(int cpu)
+{
+    struct eeefsb_memgov_cpu *c = &per_cpu(eeefsb_memgov_cpus, cpu);
+    struct perf_event_attr attr;
+    struct perf_event *event;
+    int i;
+
+    memset(&attr, 0, sizeof(attr));
+    attr.type = PERF_TYPE_HARDWARE;
+    attr.size = sizeof(attr);
+    attr.pinned = 1;
+
+    for (i = 0; i < MEMGOV_NR_EVENTS; i++) {
+        attr.config = eeefsb_memgov_config[i];
+        event = perf_event_create_kernel_counter(&attr, cpu, NULL, NULL, NULL);
+        if (IS_ERR(event)) {
+            printk(KERN_ERR "eeefsb: Unable to create perf event %i on cpu %i\n",
+                   i, cpu);
+            eeefsb_memgov_release_cpu(cpu);
+            return PTR_ERR(event);
+        }
+        c->event[i] = event;
+    }
+
+    return 0;
+}
+
+/* Called with the CPU hotplug lock and eeefsb_memgov_mutex held */
+static int eeefsb_memgov_create(void)
+{
+    int cpu, retval;
+
+    for_each_online_cpu(cpu) {
+        retval = eeefsb_memgov_create_cpu(cpu);
+        if (retval) {
+            eeefsb_memgov_release();
+            return retval;
+        }
+    }
+
+    return 0;
+}
+
+/*
+ * Follow CPUs coming and going while enabled. A CPU whose counters could
+ * not be created is left out of the sample, see eeefsb_memgov_sample().
+ */
+static int eeefsb_memgov_cpu_notify(struct notifier_block *nb,
+                                    unsigned long action, void *hcpu)
+{
+    int cpu = (long)hcpu;
+
+    mutex_lock(&eeefsb_memgov_mutex);
+    if (memgov.enabled) {
+        switch (action & ~CPU_TASKS_FROZEN) {
+        case CPU_ONLINE:
+        case CPU_DOWN_FAILED:
+            if (!per_cpu(eeefsb_memgov_cpus, cpu).event[0])
+                eeefsb_memgov_create_cpu(cpu);
+            break;
+        case CPU_DOWN_PREPARE:
+            eeefsb_memgov_release_cpu(cpu);
+            break;
+        }
+    }
+    mutex_unlock(&eeefsb_memgov_mutex);
+
+    return NOTIFY_OK;
+}
+
+static struct notifier_block eeefsb_memgov_cpu_nb = {
+    .notifier_call = eeefsb_memgov_cpu_notify,
+};
+
+/* Sum of counter deltas over all CPUs since the last call */
+static void eeefsb_memgov_sample(u64 delta[MEMGOV_NR_EVENTS], int *ncpus)
+{
+    u64 enabled, running, value;
+    int cpu, i;
+
+    memset(delta, 0, sizeof(u64) * MEMGOV_NR_EVENTS);
+    *ncpus = 0;
+    for_each_possible_cpu(cpu) {
+        struct eeefsb_memgov_cpu *c = &per_cpu(eeefsb_memgov_cpus, cpu);
+
+        if (!c->event[0])
+            continue;
+        (*ncpus)++;
+        for (i = 0; i < MEMGOV_NR_EVENTS; i++) {
+            value = perf_event_read_value(c->event[i], &enabled, &running);
+            delta[i] += value - c->last[i];
+            c->last[i] = value;
+        }
+    }
+}
+
+static void eeefsb_memgov_routine(struct work_struct *work)
+{
+    u64 delta[MEMGOV_NR_EVENTS];
+    u64 tsc, tsc_delta;
+    int ncpus, busy, mpki10, mem, score, target;
+    int f_min, f_max;
+
+    mutex_lock(&eeefsb_memgov_mutex);
+    if (!memgov.enabled) {
+        mutex_unlock(&eeefsb_memgov_mutex);
+        return;
+    }
+
+    eeefsb_memgov_sample(delta, &ncpus);
+    rdtscll(tsc);
+    tsc_delta = tsc - memgov_last_tsc;
+    memgov_last_tsc = tsc;
+    if (ncpus == 0 || tsc_delta == 0)
+        goto out;
+
+    /* Unhalted cycles against the TSC, both run at the core clock */
+    busy = (int)div64_u64(delta[MEMGOV_CYCLES] * 100, tsc_delta * ncpus);
+    if (busy > 100)
+        busy = 100;
+    mpki10 = delta[MEMGOV_INSTR] ?
+        (int)div64_u64(delta[MEMGOV_MISSES] * 10000, delta[MEMGOV_INSTR]) : 0;
+    mem = (mpki10 >= memgov.mpki_full) ? 100 : (mpki10 * 100) / memgov.mpki_full;
+    score = (memgov.w_busy * busy + memgov.w_mem * mem) /
+            (memgov.w_busy + memgov.w_mem);
+
+    f_min = eeefsb_pll_to_mhz(50, eeefsb_plan_n_min(50));
+    f_max = eeefsb_pll_to_mhz(49, eeefsb_plan_n_max(49));
+    if (busy < memgov.idle_pct)
+        target = f_min;
+    else
+        target = f_min + ((f_max - f_min) * score) / 100;
+
+    memgov_stats.busy_pct = busy;
+    memgov_stats.mpki10 = mpki10;
+    memgov_stats.score = score;
+    if (abs(target - memgov_stats.target) > memgov.hyst) {
+        memgov_stats.target = target;
+        printk(KERN_DEBUG "eeefsb: memgov busy %i%%, mpki %i.%i, target %i MHz\n",
+               busy, mpki10 / 10, mpki10 % 10, target);
+        eeefsb_wq_set_governor(target);
+    }
+
+out:
+    schedule_delayed_work(&eeefsb_memgov_task, EEEFSB_MEMGOV_PERIOD);
+    mutex_unlock(&eeefsb_memgov_mutex);
+}
+
+int eeefsb_memgov_set(const struct eeefsb_memgov_tunables *t)
+{
+    int retval = 0;
+
+    if (t->w_busy < 0 || t->w_mem < 0 || t->w_busy + t->w_mem == 0 ||
+        t->mpki_full <= 0 || t->hyst < 0)
+        return -EINVAL;
+
+    /* Only one governor at a time, before taking our mutex */
+    mutex_lock(&eeefsb_gov_mutex);
+    if (t->enabled)
+        eeefsb_loadgov_disable();
+
+    cancel_delayed_work_sync(&eeefsb_memgov_task);
+    /* No CPU may come or go between creating the counters and enabling */
+    get_online_cpus();
+    mutex_lock(&eeefsb_memgov_mutex);
+    if (t->enabled && !memgov.enabled) {
+        retval = eeefsb_memgov_create();
+        if (retval)
+            goto out;
+        memgov_stats.target = 0;
+        rdtscll(memgov_last_tsc);
+    } else if (!t->enabled && memgov.enabled) {
+        eeefsb_memgov_release();
+        eeefsb_wq_set_governor(0);
+    }
+    memgov = *t;
+    memgov.enabled = t->enabled ? 1 : 0;
+    if (memgov.enabled)
+        schedule_delayed_work(&eeefsb_memgov_task, EEEFSB_MEMGOV_PERIOD);
+out:
+    mutex_unlock(&eeefsb_memgov_mutex);
+    put_online_cpus();
+    mutex_unlock(&eeefsb_gov_mutex);
+
+    return retval;
+}
+
+void eeefsb_memgov_get(struct eeefsb_memgov_tunables *t,
+                       struct eeefsb_memgov_stats *s)
+{
+    mutex_lock(&eeefsb_memgov_mutex);
+    *t = memgov;
+    *s = memgov_stats;
+    mutex_unlock(&eeefsb_memgov_mutex);
+}
+
+/* Stop governing, the clock goes back to the user's request */
+void eeefsb_memgov_disable(void)
+{
+    cancel_delayed_work_sync(&eeefsb_memgov_task);
+    get_online_cpus();
+    mutex_lock(&eeefsb_memgov_mutex);
+    if (memgov.enabled) {
+        eeefsb_memgov_release();
+        eeefsb_wq_set_governor(0);
+    }
+    memgov.enabled = 0;
+    mutex_unlock(&eeefsb_memgov_mutex);
+    put_online_cpus();
+}
+
+void eeefsb_memgov_init(void)
+{
+    register_hotcpu_notifier(&eeefsb_memgov_cpu_nb);
+}
+
+void eeefsb_memgov_cleanup(void)
+{
+    eeefsb_memgov_disable();
+    unregister_hotcpu_notifier(&eeefsb_memgov_cpu_nb);
+}
@@ -0,0 +1,53 @@
+/*
+ *  eeefsb_memgov.h - memory stall driven FSB governor
+ *
+ *  Copyright (C) 2012 Olli Vanhoja
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  Ths program is distributed in the hope that it will be useful,
+ *  but WITOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTAILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Template Place, Suite 330, Boston, MA  02111-1307 USA
+ *  
+ *  ---------
+ *
+ *  This code comes WITHOUT ANY WARRANTY whatsoever.
+ */
+#include <linux/kernel.h>
+#include <linux/module.h>
+
+#ifndef _EEEFSB_MEMGOV_H_
+#define _EEEFSB_MEMGOV_H_
+struct eeefsb_memgov_tunables
+{
+    int enabled;
+    int w_busy;         /* Weight of core utilization */
+    int w_mem;          /* Weight of LLC misses per kilo-instruction */
+    int mpki_full;      /* MPKI considered fully memory bound (x10) */
+    int idle_pct;       /* Below this utilization go to the lowest clock */
+    int hyst;           /* Minimum target change [MHz] */
+};
+
+struct eeefsb_memgov_stats
+{
+    int busy_pct;
+    int mpki10;         /* LLC misses per kilo-instruction, x10 */
+    int score;
+    int target;
+};
+
+int eeefsb_memgov_set(const struct eeefsb_memgov_tunables *t);
+void eeefsb_memgov_get(struct eeefsb_memgov_tunables *t,
+                       struct eeefsb_memgov_stats *s);
+void eeefsb_memgov_disable(void);
+void eeefsb_memgov_init(void);
+void eeefsb_memgov_cleanup(void);
+#endif
@@ -0,0 +1,164 @@
+/*
+ *  eeefsb_plan.c - FSB ramp path planner for eeefsb
+ *
+ *  Copyright (C) 2012 Olli Vanhoja
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  Ths program is distributed in the hope that it will be useful,
+ *  but WITOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTAILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Template Place, Suite 330, Boston, MA  02111-1307 USA
+ *  
+ *  ---------
+ *
+ *  This code comes WITHOUT ANY WARRANTY whatsoever.
+ */
+
+/*** Ramp path planner ********************************************************
+ * Computes the whole list of PLL writes needed to get from the current       *
+ * operating point to the target one before anything is written.             *
+ *                                                                            *
+ * Rules:                                                                     *
+ * - N moves at most EEEFSB_MULSTEP per waypoint.                             *
+ * - M is only changed on its own waypoint and only when N is inside the      *
+ *   range valid for both M values (EEEFSB_MINFSBNH..EEEFSB_MAXFSBNL).        *
+ * - The switch point is chosen so that the total number of writes is the     *
+ *   smallest possible.                                                       *
+ * - The target N is clamped to the range of the target M, so the plan always *
+ *   ends exactly at its last waypoint.                                       *
+ *                                                                            *
+ * This file has no kernel dependencies so it can be reused by tools.         *
+ */
+#include "options.h"
+#include "eeefsb_plan.h"
+
+int eeefsb_plan_n_min(int m)
+{
+    return (m == 50) ? EEEFSB_MINFSBNL : EEEFSB_MINFSBNH;
+}
+
+int eeefsb_plan_n_max(int m)
+{
+    return (m == 50) ? EEEFSB_MAXFSBNL : EEEFSB_MAXFSBNH;
+}
+
+static int eeefsb_plan_is_known_m(int m)
+{
+    return (m == 50 || m == 49);
+}
+
+/* Number of N steps needed to get from a to b */
+static int eeefsb_plan_steps(int a, int b)
+{
+    int d = (a > b) ? a - b : b - a;
+    return (d + EEEFSB_MULSTEP - 1) / EEEFSB_MULSTEP;
+}
+
+static int eeefsb_plan_voltage(const struct eeefsb_plan *plan, int m, int n)
+{
+    int mhz = (n * plan->const_milli * EEEFSB_CPU_MUL) / (m * 1000);
+
+    return (mhz >= EEEFSB_HIVOLTFREQ) ? 1 : 0;
+}
+
+static int eeefsb_plan_add(struct eeefsb_plan *plan, int m, int n, int pcid)
+{
+    struct eeefsb_waypoint *wp;
+
+    if (plan->len >= EEEFSB_PLAN_MAX)
+        return -1;
+    wp = &plan->wp[plan->len++];
+    wp->m = m;
+    wp->n = n;
+    wp->pcid = pcid;
+    wp->voltage = eeefsb_plan_voltage(plan, m, n);
+
+    return 0;
+}
+
+/* Walk N from n_from to n_to at fixed M, n_from itself is not added */
+static int eeefsb_plan_walk(struct eeefsb_plan *plan, int m, int n_from,
+                            int n_to, int pcid)
+{
+    int n = n_from;
+
+    while (n != n_to) {
+        if (n_to > n)
+            n = (n + EEEFSB_MULSTEP > n_to) ? n_to : n + EEEFSB_MULSTEP;
+        else
+            n = (n - EEEFSB_MULSTEP < n_to) ? n_to : n - EEEFSB_MULSTEP;
+        if (eeefsb_plan_add(plan, m, n, pcid))
+            return -1;
+    }
+
+    return 0;
+}
+
+/*
+ * Build a plan from the operating point in from to (m_target, n_target).
+ * const_milli is the PLL constant (see eeefsb_pll_get_const()) used to
+ * decide the core voltage of each waypoint.
+ * Returns 0 on success, -1 if m_target isn't supported or the plan doesn't
+ * fit into EEEFSB_PLAN_MAX waypoints.
+ */
+int eeefsb_plan_build(struct eeefsb_plan *plan,
+                      const struct eeefsb_waypoint *from,
+                      int m_target, int n_target, int const_milli)
+{
+    int n_lo, n_hi;
+    int s, best_s, best_cost;
+
+    plan->len = 0;
+    plan->const_milli = const_milli;
+    if (!eeefsb_plan_is_known_m(m_target))
+        return -1;
+
+    if (n_target < eeefsb_plan_n_min(m_target))
+        n_target = eeefsb_plan_n_min(m_target);
+    else if (n_target > eeefsb_plan_n_max(m_target))
+        n_target = eeefsb_plan_n_max(m_target);
+
+    if (from->m == m_target)
+        return eeefsb_plan_walk(plan, m_target, from->n, n_target, from->pcid);
+
+    if (!eeefsb_plan_is_known_m(from->m)) {
+        /* Unknown M set by someone else, get back into a known state first */
+        s = from->n;
+        if (s < eeefsb_plan_n_min(m_target))
+            s = eeefsb_plan_n_min(m_target);
+        else if (s > eeefsb_plan_n_max(m_target))
+            s = eeefsb_plan_n_max(m_target);
+        if (eeefsb_plan_add(plan, m_target, s, from->pcid))
+            return -1;
+        return eeefsb_plan_walk(plan, m_target, s, n_target, from->pcid);
+    }
+
+    /* N range where it's safe to switch between M = 49 and M = 50 */
+    n_lo = EEEFSB_MINFSBNH;
+    n_hi = (EEEFSB_MAXFSBNL < EEEFSB_MAXFSBNH) ? EEEFSB_MAXFSBNL : EEEFSB_MAXFSBNH;
+
+    best_s = n_lo;
+    best_cost = -1;
+    for (s = n_lo; s <= n_hi; s++) {
+        int cost = eeefsb_plan_steps(from->n, s) + eeefsb_plan_steps(s, n_target);
+
+        if (best_cost < 0 || cost < best_cost) {
+            best_cost = cost;
+            best_s = s;
+        }
+    }
+
+    if (eeefsb_plan_walk(plan, from->m, from->n, best_s, from->pcid) ||
+        eeefsb_plan_add(plan, m_target, best_s, from->pcid))
+        return -1;
+
+    return eeefsb_plan_walk(plan, m_target, best_s, n_target, from->pcid);
+}
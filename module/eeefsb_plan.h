@@ -0,0 +1,49 @@
+/*
+ *  eeefsb_plan.h - FSB ramp path planner for eeefsb
+ *
+ *  Copyright (C) 2012 Olli Vanhoja
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  Ths program is distributed in the hope that it will be useful,
+ *  but WITOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTAILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Template Place, Suite 330, Boston, MA  02111-1307 USA
+ *  
+ *  ---------
+ *
+ *  This code comes WITHOUT ANY WARRANTY whatsoever.
+ */
+#ifndef _EEEFSB_PLAN_H_
+#define _EEEFSB_PLAN_H_
+#define EEEFSB_PLAN_MAX 256 /* Enough to walk N from 0 to the top */
+
+/* One PLL write and the core voltage wanted after it */
+struct eeefsb_waypoint
+{
+    int m;
+    int n;
+    int pcid;
+    int voltage;
+};
+
+struct eeefsb_plan
+{
+    int len;
+    int const_milli;
+    struct eeefsb_waypoint wp[EEEFSB_PLAN_MAX];
+};
+
+int eeefsb_plan_n_min(int m);
+int eeefsb_plan_n_max(int m);
+int eeefsb_plan_build(struct eeefsb_plan *plan,
+                      const struct eeefsb_waypoint *from,
+                      int m_target, int n_target, int const_milli);
+#endif
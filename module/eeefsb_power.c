@@ -0,0 +1,244 @@
+/*
+ *  eeefsb_power.c - power source aware policies for eeefsb
+ *
+ *  Copyright (C) 2012 Olli Vanhoja
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  Ths program is distributed in the hope that it will be useful,
+ *  but WITOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTAILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Template Place, Suite 330, Boston, MA  02111-1307 USA
+ *  
+ *  ---------
+ *
+ *  This code comes WITHOUT ANY WARRANTY whatsoever.
+ */
+
+/*** Power source policies ****************************************************
+ * Separate CPU clock floor/ceiling, voltage and fan policies for AC, battery *
+ * and low battery. ACPI AC adapter and battery events re-evaluate the power  *
+ * source right away, the battery capacity is also polled every               *
+ * EEEFSB_POWER_POLL since it changes without events. The clock limits of    *
+ * the active policy are held as the "power" QoS request, so the stepper is   *
+ * retargeted as soon as the policy changes.                                  *
+ */
+#include <linux/kernel.h>
+#include <linux/module.h>
+#include <linux/mutex.h>
+#include <linux/workqueue.h>
+#include <linux/device.h>
+#include <linux/power_supply.h>
+#include <linux/acpi.h>
+#include <acpi/acpi_bus.h>
+#include "options.h"
+#include "eeefsb_wq.h"
+#include "eeefsb_qos.h"
+#include "eeefsb_power.h"
+
+#define EEEFSB_POWER_POLL (60 * HZ)
+
+static const char *eeefsb_power_names[EEEFSB_POWER_NR_SOURCES] = {
+    "ac",
+    "battery",
+    "lowbat",
+};
+
+static struct eeefsb_power_policy eeefsb_power_policies[EEEFSB_POWER_NR_SOURCES] = {
+    { 0, INT_MAX,                0, 0 },
+    { 0, EEEFSB_BAT_MAXFREQ,     0, 0 },
+    { 0, EEEFSB_LOWBAT_MAXFREQ,  1, 0 },
+};
+
+static int eeefsb_power_lowbat = EEEFSB_LOWBAT_CAPACITY;
+static int eeefsb_power_source = -1;   /* Active policy, -1 = none yet */
+static int eeefsb_power_capacity = -1;
+static DEFINE_MUTEX(eeefsb_power_mutex);
+static struct eeefsb_qos_request eeefsb_power_qos;
+
+static void eeefsb_power_routine(struct work_struct *work);
+static void eeefsb_power_event(struct work_struct *work);
+static DECLARE_DELAYED_WORK(eeefsb_power_task, eeefsb_power_routine);
+static DECLARE_WORK(eeefsb_power_event_task, eeefsb_power_event);
+
+const char *eeefsb_power_source_name(int source)
+{
+    if (source < 0 || source >= EEEFSB_POWER_NR_SOURCES)
+        return "unknown";
+    return eeefsb_power_names[source];
+}
+
+int eeefsb_power_source_lookup(const char *name)
+{
+    int i;
+
+    for (i = 0; i < EEEFSB_POWER_NR_SOURCES; i++)
+        if (strcmp(eeefsb_power_names[i], name) == 0)
+            return i;
+    return -ENOENT;
+}
+
+static int eeefsb_power_capacity_fn(struct device *dev, void *data)
+{
+    struct power_supply *psy = dev_get_drvdata(dev);
+    union power_supply_propval val;
+    int *capacity = data;
+
+    if (psy->type != POWER_SUPPLY_TYPE_BATTERY)
+        return 0;
+    if (psy->get_property(psy, POWER_SUPPLY_PROP_CAPACITY, &val))
+        return 0;
+    *capacity = val.intval;
+
+    return 1; /* The first battery is enough */
+}
+
+/* Capacity of the battery in percent or -1 if there's none */
+static int eeefsb_power_read_capacity(void)
+{
+    int capacity = -1;
+
+    class_for_each_device(power_supply_class, NULL, &capacity,
+                          eeefsb_power_capacity_fn);
+
+    return capacity;
+}
+
+/* Apply the policy of source, called with eeefsb_power_mutex held */
+static void eeefsb_power_apply(int source)
+{
+    const struct eeefsb_power_policy *p = &eeefsb_power_policies[source];
+    int max = p->max;
+
+    if (p->low_voltage && max >= EEEFSB_HIVOLTFREQ)
+        max = EEEFSB_HIVOLTFREQ - 1;
+
+    printk(KERN_INFO "eeefsb: power source %s, clock %i..%i MHz\n",
+           eeefsb_power_names[source], p->min, max);
+    eeefsb_wq_set_fan_floor(p->fan);
+    eeefsb_qos_update_request(&eeefsb_power_qos, p->min, max);
+}
+
+/* Find out the current power source and apply its policy if it changed */
+static void eeefsb_power_update(int force)
+{
+    int source;
+
+    mutex_lock(&eeefsb_power_mutex);
+    eeefsb_power_capacity = eeefsb_power_read_capacity();
+    /* Unknown counts as AC, i.e. don't limit anything */
+    if (power_supply_is_system_supplied() != 0)
+        source = EEEFSB_POWER_AC;
+    else if (eeefsb_power_capacity >= 0 &&
+             eeefsb_power_capacity <= eeefsb_power_lowbat)
+        source = EEEFSB_POWER_LOWBAT;
+    else
+        source = EEEFSB_POWER_BATTERY;
+
+    if (force || source != eeefsb_power_source) {
+        eeefsb_power_source = source;
+        eeefsb_power_apply(source);
+    }
+    mutex_unlock(&eeefsb_power_mutex);
+}
+
+static void eeefsb_power_routine(struct work_struct *work)
+{
+    eeefsb_power_update(0);
+    schedule_delayed_work(&eeefsb_power_task, EEEFSB_POWER_POLL);
+}
+
+static void eeefsb_power_event(struct work_struct *work)
+{
+    eeefsb_power_update(0);
+}
+
+static int eeefsb_power_acpi_notify(struct notifier_block *nb,
+                                    unsigned long val, void *data)
+{
+    struct acpi_bus_event *event = data;
+
+    if (strcmp(event->device_class, "ac_adapter") == 0 ||
+        strcmp(event->device_class, "battery") == 0)
+        schedule_work(&eeefsb_power_event_task);
+
+    return NOTIFY_OK;
+}
+
+static struct notifier_block eeefsb_power_acpi_nb = {
+    .notifier_call = eeefsb_power_acpi_notify,
+};
+
+int eeefsb_power_get_source(void)
+{
+    return eeefsb_power_source;
+}
+
+int eeefsb_power_get_capacity(void)
+{
+    return eeefsb_power_capacity;
+}
+
+void eeefsb_power_get_policy(int source, struct eeefsb_power_policy *p)
+{
+    mutex_lock(&eeefsb_power_mutex);
+    *p = eeefsb_power_policies[source];
+    mutex_unlock(&eeefsb_power_mutex);
+}
+
+int eeefsb_power_set_policy(int source, const struct eeefsb_power_policy *p)
+{
+    if (source < 0 || source >= EEEFSB_POWER_NR_SOURCES ||
+        p->min < 0 || p->max < p->min || p->fan < 0 || p->fan > 100)
+        return -EINVAL;
+
+    mutex_lock(&eeefsb_power_mutex);
+    eeefsb_power_policies[source] = *p;
+    if (source == eeefsb_power_source)
+        eeefsb_power_apply(source);
+    mutex_unlock(&eeefsb_power_mutex);
+
+    return 0;
+}
+
+int eeefsb_power_get_lowbat(void)
+{
+    return eeefsb_power_lowbat;
+}
+
+int eeefsb_power_set_lowbat(int capacity)
+{
+    if (capacity < 0 || capacity > 100)
+        return -EINVAL;
+
+    mutex_lock(&eeefsb_power_mutex);
+    eeefsb_power_lowbat = capacity;
+    mutex_unlock(&eeefsb_power_mutex);
+    eeefsb_power_update(0);
+
+    return 0;
+}
+
+void eeefsb_power_init(void)
+{
+    eeefsb_qos_add_request(&eeefsb_power_qos, "power",
+                           EEEFSB_QOS_NO_MIN, EEEFSB_QOS_NO_MAX);
+    eeefsb_power_update(1);
+    register_acpi_notifier(&eeefsb_power_acpi_nb);
+    schedule_delayed_work(&eeefsb_power_task, EEEFSB_POWER_POLL);
+}
+
+void eeefsb_power_cleanup(void)
+{
+    unregister_acpi_notifier(&eeefsb_power_acpi_nb);
+    cancel_work_sync(&eeefsb_power_event_task);
+    cancel_delayed_work_sync(&eeefsb_power_task);
+    eeefsb_qos_remove_request(&eeefsb_power_qos);
+}
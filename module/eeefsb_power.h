@@ -0,0 +1,54 @@
+/*
+ *  eeefsb_power.h - power source aware policies for eeefsb
+ *
+ *  Copyright (C) 2012 Olli Vanhoja
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  Ths program is distributed in the hope that it will be useful,
+ *  but WITOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTAILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Template Place, Suite 330, Boston, MA  02111-1307 USA
+ *  
+ *  ---------
+ *
+ *  This code comes WITHOUT ANY WARRANTY whatsoever.
+ */
+#include <linux/kernel.h>
+#include <linux/module.h>
+
+#ifndef _EEEFSB_POWER_H_
+#define _EEEFSB_POWER_H_
+enum eeefsb_power_source {
+    EEEFSB_POWER_AC,
+    EEEFSB_POWER_BATTERY,
+    EEEFSB_POWER_LOWBAT,
+    EEEFSB_POWER_NR_SOURCES
+};
+
+struct eeefsb_power_policy
+{
+    int min;            /* CPU clock floor [MHz] */
+    int max;            /* CPU clock ceiling [MHz] */
+    int low_voltage;    /* 1 = stay below EEEFSB_HIVOLTFREQ */
+    int fan;            /* Minimum fan duty [%], 0 = leave it to the EC */
+};
+
+const char *eeefsb_power_source_name(int source);
+int eeefsb_power_source_lookup(const char *name);
+int eeefsb_power_get_source(void);
+int eeefsb_power_get_capacity(void);
+void eeefsb_power_get_policy(int source, struct eeefsb_power_policy *p);
+int eeefsb_power_set_policy(int source, const struct eeefsb_power_policy *p);
+int eeefsb_power_get_lowbat(void);
+int eeefsb_power_set_lowbat(int capacity);
+void eeefsb_power_init(void);
+void eeefsb_power_cleanup(void);
+#endif
@@ -0,0 +1,261 @@
+/*
+ *  eeefsb_qos.c - CPU clock QoS constraints for eeefsb
+ *
+ *  Copyright (C) 2012 Olli Vanhoja
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  Ths program is distributed in the hope that it will be useful,
+ *  but WITOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTAILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Template Place, Suite 330, Boston, MA  02111-1307 USA
+ *  
+ *  ---------
+ *
+ *  This code comes WITHOUT ANY WARRANTY whatsoever.
+ */
+
+/*** CPU clock QoS ************************************************************
+ * Modelled on PM QoS. Every client (job scheduler, latency critical service, *
+ * power policy, ...) holds a request with a minimum and/or maximum CPU      *
+ * clock. The requests are kept in two priority sorted lists so that the      *
+ * effective floor (highest minimum) and ceiling (lowest maximum) are always  *
+ * at the ends of the lists. Whenever either of them changes the stepper is   *
+ * retargeted with the new limits, see eeefsb_wq_set_limits().               *
+ *                                                                            *
+ * In-kernel users use the exported eeefsb_qos_*_request() functions.         *
+ * Userspace opens /dev/eeefsb_qos, which creates a request that lives as     *
+ * long as the file descriptor, and writes "<min> <max>" to it (0 and a      *
+ * negative value mean no constraint). Reading returns the effective limits. *
+ */
+#include <linux/kernel.h>
+#include <linux/module.h>
+#include <linux/mutex.h>
+#include <linux/list.h>
+#include <linux/plist.h>
+#include <linux/slab.h>
+#include <linux/fs.h>
+#include <linux/miscdevice.h>
+#include <asm/uaccess.h>
+#include "eeefsb_wq.h"
+#include "eeefsb_qos.h"
+
+static DEFINE_MUTEX(eeefsb_qos_mutex);
+static struct plist_head eeefsb_qos_min = PLIST_HEAD_INIT(eeefsb_qos_min);
+static struct plist_head eeefsb_qos_max = PLIST_HEAD_INIT(eeefsb_qos_max);
+static LIST_HEAD(eeefsb_qos_requests);
+static int qos_min = EEEFSB_QOS_NO_MIN;  /* Effective limits, last applied */
+static int qos_max = EEEFSB_QOS_NO_MAX;
+
+/* Recompute the limits and retarget, called with eeefsb_qos_mutex held */
+static void eeefsb_qos_update(void)
+{
+    int min = EEEFSB_QOS_NO_MIN;
+    int max = EEEFSB_QOS_NO_MAX;
+
+    if (!plist_head_empty(&eeefsb_qos_min))
+        min = plist_last(&eeefsb_qos_min)->prio;
+    if (!plist_head_empty(&eeefsb_qos_max))
+        max = plist_first(&eeefsb_qos_max)->prio;
+
+    if (min == qos_min && max == qos_max)
+        return;
+    qos_min = min;
+    qos_max = max;
+    eeefsb_wq_set_limits(min, max);
+}
+
+static void eeefsb_qos_set_nodes(struct eeefsb_qos_request *req, int min, int max)
+{
+    if (min < 0)
+        min = EEEFSB_QOS_NO_MIN;
+    if (max <= 0)
+        max = EEEFSB_QOS_NO_MAX;
+    plist_node_init(&req->min_node, min);
+    plist_add(&req->min_node, &eeefsb_qos_min);
+    plist_node_init(&req->max_node, max);
+    plist_add(&req->max_node, &eeefsb_qos_max);
+}
+
+void eeefsb_qos_add_request(struct eeefsb_qos_request *req, const char *name,
+                            int min, int max)
+{
+    if (WARN_ON(eeefsb_qos_request_active(req)))
+        return;
+
+    mutex_lock(&eeefsb_qos_mutex);
+    req->name = name;
+    req->active = 1;
+    list_add_tail(&req->list, &eeefsb_qos_requests);
+    eeefsb_qos_set_nodes(req, min, max);
+    eeefsb_qos_update();
+    mutex_unlock(&eeefsb_qos_mutex);
+}
+EXPORT_SYMBOL_GPL(eeefsb_qos_add_request);
+
+void eeefsb_qos_update_request(struct eeefsb_qos_request *req, int min, int max)
+{
+    if (WARN_ON(!eeefsb_qos_request_active(req)))
+        return;
+
+    mutex_lock(&eeefsb_qos_mutex);
+    plist_del(&req->min_node, &eeefsb_qos_min);
+    plist_del(&req->max_node, &eeefsb_qos_max);
+    eeefsb_qos_set_nodes(req, min, max);
+    eeefsb_qos_update();
+    mutex_unlock(&eeefsb_qos_mutex);
+}
+EXPORT_SYMBOL_GPL(eeefsb_qos_update_request);
+
+void eeefsb_qos_remove_request(struct eeefsb_qos_request *req)
+{
+    if (WARN_ON(!eeefsb_qos_request_active(req)))
+        return;
+
+    mutex_lock(&eeefsb_qos_mutex);
+    plist_del(&req->min_node, &eeefsb_qos_min);
+    plist_del(&req->max_node, &eeefsb_qos_max);
+    list_del(&req->list);
+    req->active = 0;
+    eeefsb_qos_update();
+    mutex_unlock(&eeefsb_qos_mutex);
+}
+EXPORT_SYMBOL_GPL(eeefsb_qos_remove_request);
+
+int eeefsb_qos_request_active(struct eeefsb_qos_request *req)
+{
+    return req->active;
+}
+EXPORT_SYMBOL_GPL(eeefsb_qos_request_active);
+
+void eeefsb_qos_get(int *min, int *max)
+{
+    mutex_lock(&eeefsb_qos_mutex);
+    *min = qos_min;
+    *max = qos_max;
+    mutex_unlock(&eeefsb_qos_mutex);
+}
+EXPORT_SYMBOL_GPL(eeefsb_qos_get);
+
+/* Print the active requests, one per line, returns the bytes written */
+int eeefsb_qos_show(char *buf, int buflen)
+{
+    struct eeefsb_qos_request *req;
+    int pos = 0;
+
+    mutex_lock(&eeefsb_qos_mutex);
+    pos += snprintf(buf + pos, buflen - pos, "# effective %d %d\n",
+                    qos_min, qos_max);
+    list_for_each_entry(req, &eeefsb_qos_requests, list) {
+        if (pos >= buflen - 64)
+            break;
+        pos += snprintf(buf + pos, buflen - pos, "%s %d %d\n", req->name,
+                        req->min_node.prio, req->max_node.prio);
+    }
+    mutex_unlock(&eeefsb_qos_mutex);
+
+    return pos;
+}
+
+/*** /dev/eeefsb_qos **********************************************************/
+static int eeefsb_qos_open(struct inode *inode, struct file *filp)
+{
+    struct eeefsb_qos_request *req;
+
+    req = kzalloc(sizeof(*req), GFP_KERNEL);
+    if (!req)
+        return -ENOMEM;
+
+    eeefsb_qos_add_request(req, "user", EEEFSB_QOS_NO_MIN, EEEFSB_QOS_NO_MAX);
+    filp->private_data = req;
+
+    return nonseekable_open(inode, filp);
+}
+
+static int eeefsb_qos_release(struct inode *inode, struct file *filp)
+{
+    struct eeefsb_qos_request *req = filp->private_data;
+
+    eeefsb_qos_remove_request(req);
+    kfree(req);
+
+    return 0;
+}
+
+static ssize_t eeefsb_qos_read(struct file *filp, char __user *ubuf,
+                               size_t count, loff_t *ppos)
+{
+    char buf[32];
+    int min, max, len;
+
+    eeefsb_qos_get(&min, &max);
+    len = snprintf(buf, sizeof(buf), "%d %d\n", min, max);
+
+    return simple_read_from_buffer(ubuf, count, ppos, buf, len);
+}
+
+static ssize_t eeefsb_qos_write(struct file *filp, const char __user *ubuf,
+                                size_t count, loff_t *ppos)
+{
+    struct eeefsb_qos_request *req = filp->private_data;
+    char buf[32];
+    int min = EEEFSB_QOS_NO_MIN;
+    int max = EEEFSB_QOS_NO_MAX;
+
+    if (count >= sizeof(buf))
+        return -EINVAL;
+    if (copy_from_user(buf, ubuf, count))
+        return -EFAULT;
+    buf[count] = 0;
+    if (sscanf(buf, "%i %i", &min, &max) < 1)
+        return -EINVAL;
+
+    eeefsb_qos_update_request(req, min, max);
+
+    return count;
+}
+
+static const struct file_operations eeefsb_qos_fops = {
+    .owner   = THIS_MODULE,
+    .open    = eeefsb_qos_open,
+    .release = eeefsb_qos_release,
+    .read    = eeefsb_qos_read,
+    .write   = eeefsb_qos_write,
+    .llseek  = no_llseek,
+};
+
+static struct miscdevice eeefsb_qos_miscdev = {
+    .minor = MISC_DYNAMIC_MINOR,
+    .name  = "eeefsb_qos",
+    .fops  = &eeefsb_qos_fops,
+};
+
+static int eeefsb_qos_registered = 0;
+
+/* The kernel side works without the device, it's userspace access only */
+int eeefsb_qos_init(void)
+{
+    int retval;
+
+    retval = misc_register(&eeefsb_qos_miscdev);
+    if (retval)
+        printk(KERN_ERR "eeefsb: Unable to register /dev/eeefsb_qos\n");
+    else
+        eeefsb_qos_registered = 1;
+
+    return retval;
+}
+
+void eeefsb_qos_cleanup(void)
+{
+    if (eeefsb_qos_registered)
+        misc_deregister(&eeefsb_qos_miscdev);
+    eeefsb_qos_registered = 0;
+}
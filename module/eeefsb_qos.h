@@ -0,0 +1,53 @@
+/*
+ *  eeefsb_qos.h - CPU clock QoS constraints for eeefsb
+ *
+ *  Copyright (C) 2012 Olli Vanhoja
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  Ths program is distributed in the hope that it will be useful,
+ *  but WITOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTAILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Template Place, Suite 330, Boston, MA  02111-1307 USA
+ *  
+ *  ---------
+ *
+ *  This code comes WITHOUT ANY WARRANTY whatsoever.
+ */
+#include <linux/kernel.h>
+#include <linux/module.h>
+#include <linux/list.h>
+#include <linux/plist.h>
+
+#ifndef _EEEFSB_QOS_H_
+#define _EEEFSB_QOS_H_
+#define EEEFSB_QOS_NO_MIN 0
+#define EEEFSB_QOS_NO_MAX INT_MAX
+
+/* A client constraint on the CPU clock [MHz], owned by the client */
+struct eeefsb_qos_request
+{
+    struct plist_node min_node;
+    struct plist_node max_node;
+    struct list_head list;
+    const char *name;
+    int active;
+};
+
+void eeefsb_qos_add_request(struct eeefsb_qos_request *req, const char *name,
+                            int min, int max);
+void eeefsb_qos_update_request(struct eeefsb_qos_request *req, int min, int max);
+void eeefsb_qos_remove_request(struct eeefsb_qos_request *req);
+int eeefsb_qos_request_active(struct eeefsb_qos_request *req);
+void eeefsb_qos_get(int *min, int *max);
+int eeefsb_qos_show(char *buf, int buflen);
+int eeefsb_qos_init(void);
+void eeefsb_qos_cleanup(void);
+#endif
@@ -0,0 +1,155 @@
+/*
+ *  eeefsb_thermal.c - emergency thermal watchdog for eeefsb
+ *
+ *  Copyright (C) 2012 Olli Vanhoja
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  Ths program is distributed in the hope that it will be useful,
+ *  but WITOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTAILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Template Place, Suite 330, Boston, MA  02111-1307 USA
+ *  
+ *  ---------
+ *
+ *  This code comes WITHOUT ANY WARRANTY whatsoever.
+ */
+
+/*** Emergency thermal watchdog ***********************************************
+ * The normal ramp takes tens of seconds to get down from an overclock. This  *
+ * watchdog polls the EC every EEEFSB_THERMAL_PERIOD and trips on            *
+ * - temperature at or above the absolute limit                               *
+ * - temperature rising faster than the slope limit, measured over the last  *
+ *   EEEFSB_THERMAL_WINDOW samples                                            *
+ * - fan at 0 RPM with a nonzero duty for EEEFSB_THERMAL_STALL samples        *
+ * A trip drops the clock straight to the safe point in one PLL write, read   *
+ * back and retried once, and runs the fan at 100 % (eeefsb_wq_emergency()).  *
+ * The clock is released when the temperature is back below limit - hyst and  *
+ * the fan is turning.                                                        *
+ */
+#include <linux/kernel.h>
+#include <linux/module.h>
+#include <linux/mutex.h>
+#include <linux/workqueue.h>
+#include "options.h"
+#include "ec.h"
+#include "eeefsb_wq.h"
+#include "eeefsb_thermal.h"
+
+#define EEEFSB_THERMAL_PERIOD (HZ / 4)  /* Polling period [jiffy] */
+#define EEEFSB_THERMAL_WINDOW 4         /* Samples for the slope, 1 s */
+#define EEEFSB_THERMAL_STALL  8         /* Samples of a stalled fan, 2 s */
+
+static struct eeefsb_thermal_tunables thermal = {
+    .limit = EEEFSB_THERMAL_LIMIT,
+    .slope = EEEFSB_THERMAL_SLOPE,
+    .stall = 1,
+    .hyst  = EEEFSB_THERMAL_HYST,
+};
+static struct eeefsb_thermal_state thermal_state;
+static unsigned int thermal_hist[EEEFSB_THERMAL_WINDOW];
+static int thermal_hist_pos = 0;
+static int thermal_hist_len = 0;
+static int thermal_stalled = 0;
+static DEFINE_MUTEX(eeefsb_thermal_mutex);
+
+static void eeefsb_thermal_routine(struct work_struct *work);
+static DECLARE_DELAYED_WORK(eeefsb_thermal_task, eeefsb_thermal_routine);
+
+static void eeefsb_thermal_trip(const char *reason, unsigned int temp,
+                                unsigned int rpm)
+{
+    int dropped;
+
+    thermal_state.tripped = 1;
+    thermal_state.trips++;
+    dropped = eeefsb_wq_emergency();
+    printk(KERN_CRIT "eeefsb: thermal emergency (%s), %u C, fan %u RPM%s\n",
+           reason, temp, rpm,
+           (dropped > 0) ? ", dropped to the safe clock" :
+           (dropped < 0) ? ", the clock could NOT be dropped" : "");
+}
+
+static void eeefsb_thermal_routine(struct work_struct *work)
+{
+    unsigned int temp, rpm, duty, oldest;
+    int slope = 0;
+
+    temp = eeefsb_get_temperature();
+    rpm  = eeefsb_fan_get_rpm();
+    duty = eeefsb_fan_get_speed();
+
+    mutex_lock(&eeefsb_thermal_mutex);
+    thermal_state.temperature = temp;
+    thermal_state.rpm = rpm;
+
+    /* Rise over the window, the oldest sample is the one overwritten next */
+    oldest = thermal_hist[thermal_hist_pos];
+    if (thermal_hist_len == EEEFSB_THERMAL_WINDOW)
+        slope = (int)temp - (int)oldest;
+    thermal_hist[thermal_hist_pos] = temp;
+    thermal_hist_pos = (thermal_hist_pos + 1) % EEEFSB_THERMAL_WINDOW;
+    if (thermal_hist_len < EEEFSB_THERMAL_WINDOW)
+        thermal_hist_len++;
+
+    if (rpm == 0 && duty > 0)
+        thermal_stalled++;
+    else
+        thermal_stalled = 0;
+
+    if (!thermal_state.tripped)
+    {
+        if (thermal.limit > 0 && (int)temp >= thermal.limit)
+            eeefsb_thermal_trip("temperature limit", temp, rpm);
+        else if (thermal.slope > 0 && slope >= thermal.slope)
+            eeefsb_thermal_trip("temperature slope", temp, rpm);
+        else if (thermal.stall && thermal_stalled >= EEEFSB_THERMAL_STALL)
+            eeefsb_thermal_trip("fan stalled", temp, rpm);
+    } else if ((thermal.limit == 0 || (int)temp + thermal.hyst < thermal.limit) &&
+               thermal_stalled == 0 && slope <= 0) {
+        thermal_state.tripped = 0;
+        printk(KERN_NOTICE "eeefsb: thermal emergency over, %u C\n", temp);
+        eeefsb_wq_emergency_clear();
+    }
+
+    schedule_delayed_work(&eeefsb_thermal_task, EEEFSB_THERMAL_PERIOD);
+    mutex_unlock(&eeefsb_thermal_mutex);
+}
+
+int eeefsb_thermal_set(const struct eeefsb_thermal_tunables *t)
+{
+    if (t->limit < 0 || t->slope < 0 || t->hyst < 0)
+        return -EINVAL;
+
+    mutex_lock(&eeefsb_thermal_mutex);
+    thermal = *t;
+    mutex_unlock(&eeefsb_thermal_mutex);
+
+    return 0;
+}
+
+void eeefsb_thermal_get(struct eeefsb_thermal_tunables *t,
+                        struct eeefsb_thermal_state *s)
+{
+    mutex_lock(&eeefsb_thermal_mutex);
+    *t = thermal;
+    *s = thermal_state;
+    mutex_unlock(&eeefsb_thermal_mutex);
+}
+
+void eeefsb_thermal_init(void)
+{
+    schedule_delayed_work(&eeefsb_thermal_task, EEEFSB_THERMAL_PERIOD);
+}
+
+void eeefsb_thermal_cleanup(void)
+{
+    cancel_delayed_work_sync(&eeefsb_thermal_task);
+}
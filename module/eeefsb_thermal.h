@@ -0,0 +1,50 @@
+/*
+ *  eeefsb_thermal.h - emergency thermal watchdog for eeefsb
+ *
+ *  Copyright (C) 2012 Olli Vanhoja
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  Ths program is distributed in the hope that it will be useful,
+ *  but WITOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTAILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Template Place, Suite 330, Boston, MA  02111-1307 USA
+ *  
+ *  ---------
+ *
+ *  This code comes WITHOUT ANY WARRANTY whatsoever.
+ */
+#include <linux/kernel.h>
+#include <linux/module.h>
+
+#ifndef _EEEFSB_THERMAL_H_
+#define _EEEFSB_THERMAL_H_
+struct eeefsb_thermal_tunables
+{
+    int limit;          /* Absolute trip temperature [C], 0 = off */
+    int slope;          /* Trip on a temperature rise of this much [C/s], 0 = off */
+    int stall;          /* 1 = trip when the fan is stalled at nonzero duty */
+    int hyst;           /* Release when this far below the limit [C] */
+};
+
+struct eeefsb_thermal_state
+{
+    int tripped;
+    int trips;
+    unsigned int temperature;
+    unsigned int rpm;
+};
+
+int eeefsb_thermal_set(const struct eeefsb_thermal_tunables *t);
+void eeefsb_thermal_get(struct eeefsb_thermal_tunables *t,
+                        struct eeefsb_thermal_state *s);
+void eeefsb_thermal_init(void);
+void eeefsb_thermal_cleanup(void);
+#endif
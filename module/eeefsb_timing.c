@@ -0,0 +1,179 @@
+/*
+ *  eeefsb_timing.c - keep kernel timekeeping in step with the FSB
+ *
+ *  Copyright (C) 2012 Olli Vanhoja
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  Ths program is distributed in the hope that it will be useful,
+ *  but WITOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTAILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Template Place, Suite 330, Boston, MA  02111-1307 USA
+ *  
+ *  ---------
+ *
+ *  This code comes WITHOUT ANY WARRANTY whatsoever.
+ */
+
+/*** Frequency transition bookkeeping *****************************************
+ * The TSC and the delay loop both run off the FSB, so every PLL write        *
+ * changes their rate behind the kernel's back. Wrap each write in            *
+ * eeefsb_timing_pre() / eeefsb_timing_post() to                              *
+ *  - send the cpufreq PRECHANGE / POSTCHANGE notifications, if a cpufreq     *
+ *    driver is around to receive them. The core clock is the driver's       *
+ *    current frequency scaled by the FSB change, not the PLL clock, so the   *
+ *    EIST state the driver keeps in policy->cur stays meaningful,            *
+ *  - rescale loops_per_jiffy and tsc_khz from the values at load time,       *
+ *    before a speed up and after a slow down so udelay() never runs short.   *
+ *    The scale is the N/M ratio, so the PLL constant (which the calibration  *
+ *    may still be refitting) cancels out,                                    *
+ *  - mark the TSC unstable on the first change. The N270 reports a constant  *
+ *    TSC, so the x86 cpufreq notifier won't do it for us, and sched_clock    *
+ *    and the clocksource must move to something that doesn't follow the FSB.*
+ */
+#include <linux/kernel.h>
+#include <linux/module.h>
+#include <linux/version.h>
+#include <linux/cpufreq.h>
+#include <linux/cpumask.h>
+#include <linux/delay.h>
+#include <asm/processor.h>
+#include <asm/tsc.h>
+#include "pll.h"
+#include "eeefsb_timing.h"
+
+/* PLL dividers the reference values below belong to */
+static int ref_m = 0;
+static int ref_n = 0;
+static unsigned long lpj_ref;
+static unsigned int tsc_khz_ref;
+static unsigned long cpu_lpj_ref[NR_CPUS];
+static int tsc_marked = 0;
+
+/* val scaled by the FSB ratio between (m_from, n_from) and (m_to, n_to) */
+static u64 eeefsb_timing_ratio(u64 val, int m_from, int n_from, int m_to, int n_to)
+{
+    return div64_u64(val * n_to * m_from, (u64)m_to * n_from);
+}
+
+/*
+ * Core clock of each CPU before and after the current transition. Both are
+ * taken once, at PRECHANGE, and POSTCHANGE reuses them: hyperthreads share
+ * a policy and the core updates policy->cur on the first POSTCHANGE, so
+ * reading it again per CPU would scale the clock twice. 0 means the CPU
+ * had no cpufreq policy.
+ */
+static unsigned int freq_old[NR_CPUS];
+static unsigned int freq_new[NR_CPUS];
+
+static void eeefsb_timing_notify(int old_m, int old_n, int new_m, int new_n,
+                                 unsigned int state)
+{
+    struct cpufreq_freqs freqs;
+    struct cpufreq_policy *policy;
+    int cpu;
+
+    freqs.flags = 0;
+    for_each_online_cpu(cpu)
+    {
+        /* Without a cpufreq driver there is nobody to tell */
+        policy = cpufreq_cpu_get(cpu);
+        if (policy == NULL)
+        {
+            freq_old[cpu] = 0;
+            continue;
+        }
+        if (state == CPUFREQ_PRECHANGE)
+        {
+            freq_old[cpu] = policy->cur;
+            freq_new[cpu] = eeefsb_timing_ratio(policy->cur, old_m, old_n,
+                                                new_m, new_n);
+        }
+        if (freq_old[cpu] == 0)
+        {
+            /* The policy appeared in the middle of the transition */
+            cpufreq_cpu_put(policy);
+            continue;
+        }
+        freqs.cpu = cpu;
+        freqs.old = freq_old[cpu];
+        freqs.new = freq_new[cpu];
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(3,9,0)
+        /* The core walks policy->cpus itself, notify once per policy */
+        if (cpu == policy->cpu)
+            cpufreq_notify_transition(policy, &freqs, state);
+#else
+        cpufreq_notify_transition(&freqs, state);
+#endif
+        cpufreq_cpu_put(policy);
+    }
+}
+
+static void eeefsb_timing_scale(int new_m, int new_n)
+{
+    int cpu;
+
+    if (ref_m <= 0 || ref_n <= 0 || new_m <= 0)
+        return;
+
+    loops_per_jiffy = eeefsb_timing_ratio(lpj_ref, ref_m, ref_n, new_m, new_n);
+    tsc_khz = eeefsb_timing_ratio(tsc_khz_ref, ref_m, ref_n, new_m, new_n);
+    for_each_possible_cpu(cpu)
+        cpu_data(cpu).loops_per_jiffy =
+            eeefsb_timing_ratio(cpu_lpj_ref[cpu], ref_m, ref_n, new_m, new_n);
+}
+
+/* Call before writing new CPU PLL dividers */
+void eeefsb_timing_pre(int old_m, int old_n, int new_m, int new_n)
+{
+    if (old_m <= 0 || old_n <= 0 || new_m <= 0 || new_n <= 0)
+        return; /* PLL read failed, nothing sensible to scale by */
+    if (old_n * new_m == new_n * old_m)
+        return;
+
+    if (!tsc_marked)
+    {
+        mark_tsc_unstable("eeefsb FSB change");
+        tsc_marked = 1;
+    }
+    eeefsb_timing_notify(old_m, old_n, new_m, new_n, CPUFREQ_PRECHANGE);
+    if (new_n * old_m > old_n * new_m)
+        eeefsb_timing_scale(new_m, new_n);
+}
+
+/* Call after the PLL write */
+void eeefsb_timing_post(int old_m, int old_n, int new_m, int new_n)
+{
+    if (old_m <= 0 || old_n <= 0 || new_m <= 0 || new_n <= 0)
+        return;
+    if (old_n * new_m == new_n * old_m)
+        return;
+
+    if (new_n * old_m < old_n * new_m)
+        eeefsb_timing_scale(new_m, new_n);
+    eeefsb_timing_notify(old_m, old_n, new_m, new_n, CPUFREQ_POSTCHANGE);
+}
+
+/*
+ * Take the current delay loop and TSC calibration as belonging to the
+ * clock we find at load time. Needs the PLL up.
+ */
+void eeefsb_timing_init(void)
+{
+    int cpu, PCID = 0;
+
+    lpj_ref = loops_per_jiffy;
+    tsc_khz_ref = tsc_khz;
+    for_each_possible_cpu(cpu)
+        cpu_lpj_ref[cpu] = cpu_data(cpu).loops_per_jiffy;
+    eeefsb_get_freq(&ref_m, &ref_n, &PCID);
+    if (ref_m <= 0 || ref_n <= 0)
+        ref_m = ref_n = 0; /* Can't scale without a reference */
+}
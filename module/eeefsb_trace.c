@@ -0,0 +1,179 @@
+/*
+ *  eeefsb_trace.c - PLL and EC transaction recorder
+ *
+ *  Copyright (C) 2012 Olli Vanhoja
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  Ths program is distributed in the hope that it will be useful,
+ *  but WITOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTAILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Template Place, Suite 330, Boston, MA  02111-1307 USA
+ *  
+ *  ---------
+ *
+ *  This code comes WITHOUT ANY WARRANTY whatsoever.
+ */
+
+/*** Transaction recorder *****************************************************
+ * Every SMBus block transfer in pll.c and every Index IO access in ec.c is   *
+ * logged into a ring buffer of EEEFSB_TRACE_RECS records while recording is  *
+ * enabled. Files under /sys/kernel/debug/eeefsb:                             *
+ * trace_enable = 1 to record, 0 to stop                                      *
+ * trace        = The recorded struct eeefsb_trace_rec records, oldest first. *
+ *                Writing anything clears the buffer.                         *
+ *                                                                            *
+ * Compiled in only if EEEFSB_TRACE is defined in options.h. Feed the dump to *
+ * tools/eeefsb-replay for offline analysis.                                  *
+ */
+#include <linux/kernel.h>
+#include <linux/module.h>
+#include <linux/fs.h>
+#include <linux/debugfs.h>
+#include <linux/spinlock.h>
+#include <linux/vmalloc.h>
+#include <linux/ktime.h>
+#include <asm/uaccess.h>
+#include "eeefsb_debugfs.h"
+#include "eeefsb_trace.h"
+
+#ifdef EEEFSB_TRACE
+
+#define EEEFSB_TRACE_RECS 4096
+
+static struct eeefsb_trace_rec *eeefsb_trace_buf;
+static unsigned int trace_head = 0;     /* Next record to write */
+static unsigned int trace_count = 0;    /* Valid records in the buffer */
+static u32 trace_enable = 0;
+static DEFINE_SPINLOCK(eeefsb_trace_lock);
+
+/* Start timestamp for a transfer, 0 if we aren't recording */
+u64 eeefsb_trace_clock(void)
+{
+    if (!trace_enable || !eeefsb_trace_buf)
+        return 0;
+    return ktime_to_ns(ktime_get());
+}
+
+void eeefsb_trace_record(int type, u16 addr, const void *data, int len,
+                         int result, u64 start)
+{
+    struct eeefsb_trace_rec *rec;
+    unsigned long flags;
+    u64 now;
+
+    if (!start)
+        return;
+    now = ktime_to_ns(ktime_get());
+
+    spin_lock_irqsave(&eeefsb_trace_lock, flags);
+    if (!eeefsb_trace_buf) {
+        spin_unlock_irqrestore(&eeefsb_trace_lock, flags);
+        return;
+    }
+    rec = &eeefsb_trace_buf[trace_head];
+    memset(rec, 0, sizeof(*rec));
+    rec->ts_ns = start;
+    rec->dur_ns = (u32)min_t(u64, now - start, 0xffffffff);
+    rec->type = type;
+    rec->len = (len < 0) ? 0 : len;
+    rec->addr = addr;
+    rec->result = result;
+    if (data && len > 0)
+        memcpy(rec->data, data, min(len, EEEFSB_TRACE_DATA));
+    trace_head = (trace_head + 1) % EEEFSB_TRACE_RECS;
+    if (trace_count < EEEFSB_TRACE_RECS)
+        trace_count++;
+    spin_unlock_irqrestore(&eeefsb_trace_lock, flags);
+}
+
+static ssize_t eeefsb_trace_read(struct file *file, char __user *ubuf,
+                                 size_t count, loff_t *ppos)
+{
+    struct eeefsb_trace_rec rec;
+    unsigned long flags;
+    size_t done = 0;
+
+    while (done < count) {
+        unsigned int idx = *ppos / sizeof(rec);
+        unsigned int off = *ppos % sizeof(rec);
+        size_t len;
+
+        spin_lock_irqsave(&eeefsb_trace_lock, flags);
+        if (idx >= trace_count) {
+            spin_unlock_irqrestore(&eeefsb_trace_lock, flags);
+            break;
+        }
+        rec = eeefsb_trace_buf[(trace_head + EEEFSB_TRACE_RECS - trace_count + idx) %
+                               EEEFSB_TRACE_RECS];
+        spin_unlock_irqrestore(&eeefsb_trace_lock, flags);
+
+        len = min_t(size_t, sizeof(rec) - off, count - done);
+        if (copy_to_user(ubuf + done, (char *)&rec + off, len))
+            return done ? done : -EFAULT;
+        *ppos += len;
+        done += len;
+    }
+
+    return done;
+}
+
+static ssize_t eeefsb_trace_write(struct file *file, const char __user *ubuf,
+                                  size_t count, loff_t *ppos)
+{
+    unsigned long flags;
+
+    spin_lock_irqsave(&eeefsb_trace_lock, flags);
+    trace_head = 0;
+    trace_count = 0;
+    spin_unlock_irqrestore(&eeefsb_trace_lock, flags);
+
+    return count;
+}
+
+static const struct file_operations eeefsb_trace_fops = {
+    .owner  = THIS_MODULE,
+    .read   = eeefsb_trace_read,
+    .write  = eeefsb_trace_write,
+    .llseek = default_llseek,
+};
+
+void eeefsb_trace_init(void)
+{
+    struct dentry *root = eeefsb_debugfs_root();
+
+    if (!root)
+        return;
+
+    eeefsb_trace_buf = vmalloc(sizeof(*eeefsb_trace_buf) * EEEFSB_TRACE_RECS);
+    if (!eeefsb_trace_buf) {
+        printk(KERN_ERR "eeefsb: Unable to allocate the trace buffer\n");
+        return;
+    }
+
+    debugfs_create_u32("trace_enable", 0600, root, &trace_enable);
+    debugfs_create_file("trace", 0600, root, NULL, &eeefsb_trace_fops);
+}
+
+void eeefsb_trace_cleanup(void)
+{
+    struct eeefsb_trace_rec *buf;
+    unsigned long flags;
+
+    /* The files go with the debugfs directory */
+    trace_enable = 0;
+    spin_lock_irqsave(&eeefsb_trace_lock, flags);
+    buf = eeefsb_trace_buf;
+    eeefsb_trace_buf = NULL;
+    spin_unlock_irqrestore(&eeefsb_trace_lock, flags);
+    vfree(buf);
+}
+
+#endif /* EEEFSB_TRACE */
@@ -0,0 +1,76 @@
+/*
+ *  eeefsb_trace.h - PLL and EC transaction recorder
+ *
+ *  Copyright (C) 2012 Olli Vanhoja
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  Ths program is distributed in the hope that it will be useful,
+ *  but WITOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTAILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Template Place, Suite 330, Boston, MA  02111-1307 USA
+ *  
+ *  ---------
+ *
+ *  This code comes WITHOUT ANY WARRANTY whatsoever.
+ */
+#ifndef _EEEFSB_TRACE_H_
+#define _EEEFSB_TRACE_H_
+#ifdef __KERNEL__
+#include <linux/types.h>
+#include "options.h"
+#else
+#include <stdint.h>
+typedef uint8_t  u8;
+typedef uint16_t u16;
+typedef uint32_t u32;
+typedef int32_t  s32;
+typedef uint64_t u64;
+#endif
+
+/*** Trace record format ******************************************************
+ * Shared with tools/eeefsb-replay. Records are written to debugfs oldest     *
+ * first in host byte order.                                                  *
+ */
+#define EEEFSB_TRACE_PLL_READ  1    /* SMBus block read, data = block        */
+#define EEEFSB_TRACE_PLL_WRITE 2    /* SMBus block write, data = block       */
+#define EEEFSB_TRACE_EC_READ   3    /* Index IO read, addr = first address   */
+#define EEEFSB_TRACE_EC_WRITE  4    /* Index IO write, addr = first address  */
+#define EEEFSB_TRACE_DATA      32   /* Bytes of data kept per record         */
+
+struct eeefsb_trace_rec
+{
+    u64 ts_ns;      /* Start of the transfer, monotonic clock */
+    u32 dur_ns;     /* Duration of the transfer */
+    u8  type;
+    u8  pad;
+    u16 len;        /* Bytes transferred, only the first 32 are kept */
+    u16 addr;
+    u16 pad2;
+    s32 result;     /* Return value, bytes or a negative errno */
+    u8  data[EEEFSB_TRACE_DATA];
+} __attribute__((packed));
+
+#ifdef __KERNEL__
+#ifdef EEEFSB_TRACE
+u64 eeefsb_trace_clock(void);
+void eeefsb_trace_record(int type, u16 addr, const void *data, int len,
+                         int result, u64 start);
+void eeefsb_trace_init(void);
+void eeefsb_trace_cleanup(void);
+#else
+static inline u64 eeefsb_trace_clock(void) { return 0; }
+static inline void eeefsb_trace_record(int type, u16 addr, const void *data,
+                                       int len, int result, u64 start) { }
+static inline void eeefsb_trace_init(void) { }
+static inline void eeefsb_trace_cleanup(void) { }
+#endif
+#endif
+#endif
@@ -30,6 +30,7 @@
  */
 #include <linux/kernel.h>
 #include <linux/module.h>
+#include <linux/mutex.h>
 #include <linux/sched.h>        /* We need to put ourselves to sleep
                                    and wake up later */
 #include <linux/init.h>         /* For __init and __exit */
@@ -37,6 +38,10 @@
 #include "options.h"
 #include "pll.h"
 #include "ec.h"
+#include "eeefsb_plan.h"
+#include "eeefsb_calib.h"
+#include "eeefsb_timing.h"
+#include "eeefsb_wq.h"
  
 #define EEEFSB_WORK_QUEUE_NAME "WQeeefsb.c"
 
@@ -48,6 +53,23 @@ static int n_current   = EEEFSB_CPU_N_SAFE;
 static int m_target    = EEEFSB_CPU_M_SAFE;
 static int m_current   = EEEFSB_CPU_M_SAFE;
 static int pci_target  = EEEFSB_PCI_SAFE;
+static int v_current   = 1;
+
+/* Last requested clock and the limits it is clamped to [MHz] */
+static int freq_request = 0;
+static int freq_governor = 0; /* Set by memgov or loadgov, 0 if neither runs */
+static int freq_min     = 0;
+static int freq_max     = INT_MAX;
+static unsigned int fan_floor = 0;
+static int emergency   = 0; /* Held at the safe clock by eeefsb_wq_emergency() */
+static int fan_stale   = 0; /* Fan settings must be reapplied on the next ramp */
+static unsigned long last_change = 0; /* jiffies of the last PLL write */
+static unsigned int step_us = 0;      /* Measured time per ramp step [us] */
+
+/* The ramp currently being walked and the index of the next waypoint */
+static struct eeefsb_plan eeefsb_ramp;
+static int eeefsb_ramp_pos = 0;
+static DEFINE_MUTEX(eeefsb_wq_mutex);
 
 /* The work queue structure for this task, from workqueue.h */
 static struct workqueue_struct *eeefsb_workqueue;
@@ -55,120 +77,390 @@ static struct workqueue_struct *eeefsb_workqueue;
 static struct delayed_work eeefsb_task;
 static DECLARE_DELAYED_WORK(eeefsb_task, intrpt_routine);
 
-void eeefsb_wq_start(int cpu_freq)
+/*
+ * Requested clock clamped to the current limits. A governor's target takes
+ * the place of the user's request while it runs. The ceiling wins if the
+ * limits cross, it's the one that keeps the machine alive.
+ */
+static int eeefsb_wq_effective(void)
 {
-    int cpuM = 0;
-    int cpuN = 0;
-    int PCID = 0;
+    int cpu_freq = freq_governor ? freq_governor : freq_request;
 
-    eeefsb_get_freq(&cpuM, &cpuN, &PCID);
-    n_current  = cpuN;
-    m_current  = cpuM;
-    pci_target = PCID;
-    
-    if (cpu_freq <= 1775)
+    if (cpu_freq < freq_min)
+        cpu_freq = freq_min;
+    if (cpu_freq > freq_max)
+        cpu_freq = freq_max;
+    if (emergency && cpu_freq > eeefsb_pll_to_mhz(EEEFSB_CPU_M_SAFE, EEEFSB_CPU_N_SAFE))
+        cpu_freq = eeefsb_pll_to_mhz(EEEFSB_CPU_M_SAFE, EEEFSB_CPU_N_SAFE);
+
+    return cpu_freq;
+}
+
+/*
+ * PLL M and N for cpu_freq, M = 49 is only needed above 1774 MHz. N is the
+ * highest one that doesn't go over cpu_freq, so a clock read back from the
+ * PLL maps to the same M and N again.
+ */
+static void eeefsb_wq_target(int cpu_freq, int *m, int *n)
+{
+    *m = (emergency || cpu_freq <= 1775) ? 50 : 49;
+    *n = eeefsb_pll_to_n(cpu_freq, *m);
+    if (eeefsb_pll_to_mhz(*m, *n + 1) <= cpu_freq)
+        (*n)++;
+    if (*n < eeefsb_plan_n_min(*m))
+        *n = eeefsb_plan_n_min(*m);
+    else if (*n > eeefsb_plan_n_max(*m))
+        *n = eeefsb_plan_n_max(*m);
+}
+
+/*
+ * Fan settings for cpu_freq: the floor, or back to the EC, up to 1774 MHz
+ * and a duty that grows with the clock above. Full speed is left alone in
+ * an emergency. Must be called with eeefsb_wq_mutex held.
+ */
+static void eeefsb_wq_fan(int cpu_freq)
+{
+    if (emergency)
+    {
+        /* Leave the fan at full speed */
+    } else if (cpu_freq <= 1775)
     {
-        /* Set back to automatic fan control by EC */
-        eeefsb_fan_set_control(0);
-        
-        m_target = 50; /* for frequencies <= 1774 MHz */
+        if (fan_floor > 0)
+        {
+            eeefsb_fan_set_control(1);
+            eeefsb_fan_set_speed(fan_floor);
+        } else {
+            /* Set back to automatic fan control by EC */
+            eeefsb_fan_set_control(0);
+        }
     } else { /* CPU clock over 1774 MHz was requested */
+        unsigned int fan_speed;
+
         /* This is mandatory ...but remember to not set your laptop on sleep  *
          * or your CPU will be toasted on start up                            *
          */
         eeefsb_fan_set_control(1);
         /* Calculate needed fan speed */
-        eeefsb_fan_set_speed((unsigned int)(80 + (cpu_freq - 1782) / 2));
-        
-        m_target = 49; /* for frequencies above 1774 MHz */
+        fan_speed = (unsigned int)(80 + (cpu_freq - 1782) / 2);
+        eeefsb_fan_set_speed((fan_speed < fan_floor) ? fan_floor : fan_speed);
     }
-    
-    /* Calculate new N */
-    n_target = (cpu_freq * m_target) / (EEEFSB_PLL_CONST_MUL * EEEFSB_CPU_MUL);
-    
-    die = 0;
-    queue_delayed_work(eeefsb_workqueue, &eeefsb_task, EEEFSB_STEPDELAY);
 }
 
-/* 
- * This function will be called on every timer interrupt.
+/*
+ * Plan a new ramp to cpu_freq starting from the current PLL state.
+ * Must be called with eeefsb_wq_mutex held and eeefsb_task cancelled.
  */
-static void intrpt_routine(struct work_struct *private_)
+static void eeefsb_wq_ramp(int cpu_freq)
 {
-    int min_fsb_n;
-    int max_fsb_n;
+    struct eeefsb_waypoint from;
+
+    eeefsb_get_freq(&from.m, &from.n, &from.pcid);
+    from.voltage = eeefsb_get_voltage();
+    n_current  = from.n;
+    m_current  = from.m;
+    pci_target = from.pcid;
+    v_current  = from.voltage;
+
+    /* Calculate new M and N */
+    eeefsb_wq_target(cpu_freq, &m_target, &n_target);
+    eeefsb_ramp_pos = 0;
+    eeefsb_ramp.len = 0;
+
+    /* Already there, leave the PLL and the fan alone */
+    if (m_target == from.m && n_target == from.n && !fan_stale)
+        return;
+    fan_stale = 0;
     
-    /* Update M now? */
-    if ((n_target > n_current) && (m_target > m_current))
+    eeefsb_wq_fan(cpu_freq);
+    
+    if (m_target == from.m && n_target == from.n)
+        return;
+    if (eeefsb_plan_build(&eeefsb_ramp, &from, m_target, n_target,
+                          eeefsb_pll_get_const()))
     {
-        m_current = m_target;
-        eeefsb_set_freq(m_current, n_current, pci_target);
-        printk(KERN_DEBUG "eeefsb: (a) set m = %i", m_current);
+        printk(KERN_ERR "eeefsb: Unable to plan a ramp from %i/%i to %i/%i\n",
+               from.m, from.n, m_target, n_target);
+        eeefsb_ramp.len = 0;
     }
+    printk(KERN_DEBUG "eeefsb: planned %i steps to m = %i, n = %i\n",
+           eeefsb_ramp.len, m_target, n_target);
+    
+    /* Nothing gets queued once cleanup has begun */
+    if (die == 0 && eeefsb_ramp.len > 0)
+        queue_delayed_work(eeefsb_workqueue, &eeefsb_task, EEEFSB_STEPDELAY);
+}
 
-    // Increment or decrement N */
-    if (n_target > n_current)
-    {
-        /* Target frequency is higher than current CPU frequency */
-        if ((n_current + EEEFSB_MULSTEP) > n_target)
-        {
-            n_current = n_target;
-        }
-        else
-        {
-            n_current += EEEFSB_MULSTEP;
-        }
-        eeefsb_set_freq(m_target, n_current, pci_target);
-    }
-    else if (n_target < n_current) 
+void eeefsb_wq_start(int cpu_freq)
+{
+    /* Stop the old ramp where it is, it will be replanned from there */
+    cancel_delayed_work_sync(&eeefsb_task);
+
+    mutex_lock(&eeefsb_wq_mutex);
+    freq_request = cpu_freq;
+    eeefsb_wq_ramp(eeefsb_wq_effective());
+    mutex_unlock(&eeefsb_wq_mutex);
+}
+
+/*
+ * Target of the in-module governor [MHz], clamped to the same limits as the
+ * user's request. 0 hands the clock back to the user's request, which the
+ * governor leaves untouched.
+ */
+void eeefsb_wq_set_governor(int cpu_freq)
+{
+    cancel_delayed_work_sync(&eeefsb_task);
+
+    mutex_lock(&eeefsb_wq_mutex);
+    freq_governor = cpu_freq;
+    if (freq_request == 0)
+        freq_request = eeefsb_get_cpu_freq();
+    eeefsb_wq_ramp(eeefsb_wq_effective());
+    mutex_unlock(&eeefsb_wq_mutex);
+}
+
+/*
+ * Set the floor and ceiling for the requested clock [MHz] and retarget the
+ * stepper right away. If nothing has been requested yet the current clock
+ * is taken as the request.
+ */
+void eeefsb_wq_set_limits(int min, int max)
+{
+    cancel_delayed_work_sync(&eeefsb_task);
+
+    mutex_lock(&eeefsb_wq_mutex);
+    freq_min = min;
+    freq_max = max;
+    if (freq_request == 0)
+        freq_request = eeefsb_get_cpu_freq();
+    eeefsb_wq_ramp(eeefsb_wq_effective());
+    mutex_unlock(&eeefsb_wq_mutex);
+}
+
+/*
+ * Emergency drop, bypasses the ramp: abort any ramp in progress and go
+ * straight to the safe operating point in a single PLL write if we are
+ * above it, then run the fan at full speed. The write is read back and
+ * tried once more if the PLL didn't take it. The clock is held at or below
+ * the safe point until eeefsb_wq_emergency_clear().
+ * Returns 1 if the clock was dropped, 0 if it already was at or below the
+ * safe point and -EIO if the PLL didn't get there. The fan stays at full
+ * speed either way.
+ */
+int eeefsb_wq_emergency(void)
+{
+    int cpuM = 0;
+    int cpuN = 0;
+    int PCID = 0;
+    int newM, newN, tries;
+    int dropped = 0;
+    int safe_v, old_mhz, safe_mhz;
+
+    cancel_delayed_work_sync(&eeefsb_task);
+
+    mutex_lock(&eeefsb_wq_mutex);
+    emergency = 1;
+    fan_stale = 1; /* Take the fan back from full speed on release */
+    eeefsb_ramp.len = 0;
+    eeefsb_ramp_pos = 0;
+
+    eeefsb_fan_set_control(1);
+    eeefsb_fan_set_speed(100);
+
+    eeefsb_get_freq(&cpuM, &cpuN, &PCID);
+    old_mhz = eeefsb_pll_to_mhz(cpuM, cpuN);
+    safe_mhz = eeefsb_pll_to_mhz(EEEFSB_CPU_M_SAFE, EEEFSB_CPU_N_SAFE);
+    for (tries = 0; tries < 2 && old_mhz > safe_mhz; tries++)
     {
-        /* Target frequency is lower than current CPU frequency */
-        if ((n_current - EEEFSB_MULSTEP) < n_target)
+        eeefsb_timing_pre(cpuM, cpuN, EEEFSB_CPU_M_SAFE, EEEFSB_CPU_N_SAFE);
+        eeefsb_set_freq(EEEFSB_CPU_M_SAFE, EEEFSB_CPU_N_SAFE, PCID);
+        last_change = jiffies;
+
+        /* Only trust the safe clock once the PLL reports it */
+        newM = newN = 0;
+        eeefsb_get_freq(&newM, &newN, &PCID);
+        if (newM <= 0 || newN <= 0)
         {
-            n_current = n_target;
+            printk(KERN_ERR "eeefsb: Unable to read back the emergency PLL write\n");
+            continue;
         }
+        eeefsb_timing_post(cpuM, cpuN, newM, newN);
+        m_current = cpuM = newM;
+        n_current = cpuN = newN;
+        old_mhz = eeefsb_pll_to_mhz(cpuM, cpuN);
+        if (cpuM == EEEFSB_CPU_M_SAFE && cpuN == EEEFSB_CPU_N_SAFE)
+            dropped = 1;
         else
-        {
-            n_current -= EEEFSB_MULSTEP;
-        }
-        eeefsb_set_freq(m_target, n_current, pci_target);
+            printk(KERN_ERR "eeefsb: Emergency PLL write didn't take, m = %i, n = %i\n",
+                   cpuM, cpuN);
     }
-    
-    /* Check N min & max */
-    min_fsb_n = (m_current == 50) ? EEEFSB_MINFSBNL : EEEFSB_MINFSBNH;
-    max_fsb_n = (m_target == 50 &&  m_target < m_current) ? EEEFSB_MAXFSBNL : EEEFSB_MAXFSBNH;
-    if (n_current <= min_fsb_n)
+
+    if (dropped)
     {
-        n_current = min_fsb_n;
-        die = 1;
-    }
-    else if (n_current >= max_fsb_n)
+        /* Lower the voltage only after the clock is down */
+        safe_v = (safe_mhz >= EEEFSB_HIVOLTFREQ) ? 1 : 0;
+        eeefsb_set_voltage(safe_v);
+        v_current = safe_v;
+    } else if (old_mhz > safe_mhz)
     {
-        n_current = max_fsb_n;
-        die = 1;
+        printk(KERN_ERR "eeefsb: Emergency drop failed, still at %i MHz, fan kept at 100%%\n",
+               old_mhz);
+        dropped = -EIO;
     }
-        
-    /* Is it safe to update M? */
-    if (((n_current == n_target) || die || (n_current-1 == min_fsb_n)) && (m_target != m_current))
+    mutex_unlock(&eeefsb_wq_mutex);
+
+    return dropped;
+}
+
+/*
+ * Release the hold set by eeefsb_wq_emergency() and go back to the
+ * requested clock.
+ */
+void eeefsb_wq_emergency_clear(void)
+{
+    cancel_delayed_work_sync(&eeefsb_task);
+
+    mutex_lock(&eeefsb_wq_mutex);
+    emergency = 0;
+    if (freq_request == 0)
+        freq_request = eeefsb_get_cpu_freq();
+    eeefsb_wq_ramp(eeefsb_wq_effective());
+    mutex_unlock(&eeefsb_wq_mutex);
+}
+
+/*
+ * Minimum fan duty [%] while we are in control of the clock, 0 leaves the
+ * fan to the EC unless overclocking needs it. Applied right away, the clock
+ * limits may well not change with it.
+ */
+void eeefsb_wq_set_fan_floor(unsigned int duty)
+{
+    mutex_lock(&eeefsb_wq_mutex);
+    if (duty > 100)
+        duty = 100;
+    if (duty != fan_floor)
     {
-        m_current = m_target;
-        eeefsb_set_freq(m_current, n_current, pci_target);
-        printk(KERN_DEBUG "eeefsb: (b) set m = %i", m_current);
+        fan_floor = duty;
+        if (freq_request == 0)
+            freq_request = eeefsb_get_cpu_freq();
+        eeefsb_wq_fan(eeefsb_wq_effective());
     }
-    
-    /* Set high cpu core voltage if needed */
-    if (((n_current * EEEFSB_PLL_CONST_MUL * EEEFSB_CPU_MUL) / m_target) >= EEEFSB_HIVOLTFREQ)
+    mutex_unlock(&eeefsb_wq_mutex);
+}
+
+/*
+ * jiffies of the last clock change (0 if none yet), *ramping is set if a
+ * ramp is still in progress.
+ */
+unsigned long eeefsb_wq_last_change(int *ramping)
+{
+    unsigned long t;
+
+    mutex_lock(&eeefsb_wq_mutex);
+    t = last_change;
+    *ramping = (eeefsb_ramp_pos < eeefsb_ramp.len) ? 1 : 0;
+    mutex_unlock(&eeefsb_wq_mutex);
+
+    return t;
+}
+
+/*
+ * Estimated time to ramp from the current clock to cpu_freq [ms], from the
+ * number of steps the planner would take and the measured time per step.
+ * Returns -1 if no ramp can be planned.
+ */
+int eeefsb_wq_ramp_estimate(int cpu_freq)
+{
+    static struct eeefsb_plan plan; /* Too big for the stack */
+    struct eeefsb_waypoint from;
+    int m, n, ms = -1;
+
+    mutex_lock(&eeefsb_wq_mutex);
+    eeefsb_get_freq(&from.m, &from.n, &from.pcid);
+    from.voltage = v_current;
+    eeefsb_wq_target(cpu_freq, &m, &n);
+    if (eeefsb_plan_build(&plan, &from, m, n, eeefsb_pll_get_const()) == 0)
+        ms = (int)(((u64)plan.len * step_us) / 1000);
+    mutex_unlock(&eeefsb_wq_mutex);
+
+    return ms;
+}
+
+/*
+ * Clock the PLL was last set to or read at [MHz]. Mid-ramp this is the
+ * last waypoint written, not the target.
+ */
+int eeefsb_wq_get_current(void)
+{
+    int mhz;
+
+    mutex_lock(&eeefsb_wq_mutex);
+    mhz = eeefsb_pll_to_mhz(m_current, n_current);
+    mutex_unlock(&eeefsb_wq_mutex);
+
+    return mhz;
+}
+
+/*
+ * Copy the current ramp plan, returns the index of the next waypoint.
+ */
+int eeefsb_wq_get_plan(struct eeefsb_plan *plan)
+{
+    int pos;
+
+    mutex_lock(&eeefsb_wq_mutex);
+    memcpy(plan, &eeefsb_ramp, sizeof(*plan));
+    pos = eeefsb_ramp_pos;
+    mutex_unlock(&eeefsb_wq_mutex);
+
+    return pos;
+}
+
+/* 
+ * This function will be called on every timer interrupt.
+ * Every call writes exactly one waypoint of the planned ramp.
+ */
+static void intrpt_routine(struct work_struct *private_)
+{
+    struct eeefsb_waypoint *wp;
+    int old_m, old_n;
+
+    mutex_lock(&eeefsb_wq_mutex);
+    if (die || eeefsb_ramp_pos >= eeefsb_ramp.len)
     {
-        eeefsb_set_voltage(1);
-    } else {
-        eeefsb_set_voltage(0);
+        mutex_unlock(&eeefsb_wq_mutex);
+        return;
     }
+    wp = &eeefsb_ramp.wp[eeefsb_ramp_pos++];
+    old_m = m_current;
+    old_n = n_current;
+
+    /* Raise the core voltage before the clock, lower it after */
+    if (wp->voltage > v_current)
+        eeefsb_set_voltage(wp->voltage);
+    eeefsb_timing_pre(old_m, old_n, wp->m, wp->n);
+    eeefsb_set_freq(wp->m, wp->n, wp->pcid);
+    eeefsb_timing_post(old_m, old_n, wp->m, wp->n);
+    /* Time per step, from the previous write of the same ramp */
+    if (eeefsb_ramp_pos > 1)
+        step_us = (3 * step_us + jiffies_to_usecs(jiffies - last_change)) / 4;
+    last_change = jiffies;
+    if (wp->voltage < v_current)
+        eeefsb_set_voltage(wp->voltage);
+
+    if (wp->m != m_current)
+        printk(KERN_DEBUG "eeefsb: set m = %i\n", wp->m);
+    m_current = wp->m;
+    n_current = wp->n;
+    v_current = wp->voltage;
     
     printk(KERN_DEBUG "eeefsb: set n = %i, target = %i\n", n_current, n_target);
     
 	/* If cleanup wants us to die */
-	if (die == 0 && n_current != n_target)
+	if (die == 0 && eeefsb_ramp_pos < eeefsb_ramp.len)
 		queue_delayed_work(eeefsb_workqueue, &eeefsb_task, EEEFSB_STEPDELAY);
+    else if (die == 0)
+        eeefsb_calib_start(m_current, n_current); /* Ramp done, check it */
+    mutex_unlock(&eeefsb_wq_mutex);
 }
 
 /*
@@ -176,6 +468,18 @@ static void intrpt_routine(struct work_struct *private_)
  */
 void eeefsb_wq_init(void)
 {
+    int cpuM = 0;
+    int cpuN = 0;
+    int PCID = 0;
+
+    step_us = jiffies_to_usecs(EEEFSB_STEPDELAY);
+    /* Start from what the PLL runs at, not the safe defaults */
+    eeefsb_get_freq(&cpuM, &cpuN, &PCID);
+    if (cpuM > 0 && cpuN > 0)
+    {
+        m_current = cpuM;
+        n_current = cpuN;
+    }
     eeefsb_workqueue = create_workqueue(EEEFSB_WORK_QUEUE_NAME);
 }
 
@@ -184,8 +488,10 @@ void eeefsb_wq_init(void)
  */
 void eeefsb_wq_cleanup(void)
 {
+    mutex_lock(&eeefsb_wq_mutex);
     die = 1;                     /* keep intrp_routine from queueing itself */
-	cancel_delayed_work(&eeefsb_task); /* no "new ones"                     */
+    mutex_unlock(&eeefsb_wq_mutex);
+	cancel_delayed_work_sync(&eeefsb_task); /* no "new ones"                */
 	flush_workqueue(eeefsb_workqueue); /* wait till all "old ones" finished */
 	destroy_workqueue(eeefsb_workqueue);
     
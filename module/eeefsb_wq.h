@@ -23,11 +23,21 @@
  */
  #include <linux/kernel.h>
 #include <linux/module.h>
+#include "eeefsb_plan.h"
 
 #ifndef _EEEFSB_WQ_H_
 #define _EEEFSB_WQ_H_
 /*void intrpt_routine(struct work_struct *private_);*/
 void eeefsb_wq_start(int cpu_freq);
+void eeefsb_wq_set_governor(int cpu_freq);
+void eeefsb_wq_set_limits(int min, int max);
+void eeefsb_wq_set_fan_floor(unsigned int duty);
+int eeefsb_wq_emergency(void);
+void eeefsb_wq_emergency_clear(void);
+int eeefsb_wq_get_plan(struct eeefsb_plan *plan);
+unsigned long eeefsb_wq_last_change(int *ramping);
+int eeefsb_wq_ramp_estimate(int cpu_freq);
+int eeefsb_wq_get_current(void);
 void eeefsb_wq_init(void);
 void eeefsb_wq_cleanup(void);
 #endif
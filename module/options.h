@@ -35,3 +35,15 @@
 #define EEEFSB_CPU_MUL       12    // From datasheet
 #define EEEFSB_PCI_SAFE      15
 
+#define EEEFSB_BAT_MAXFREQ     1600  // Default CPU speed ceiling on battery [MHz]
+#define EEEFSB_LOWBAT_MAXFREQ  1100  // Default CPU speed ceiling on low battery [MHz]
+#define EEEFSB_LOWBAT_CAPACITY 15    // Battery capacity considered low [%]
+#define EEEFSB_THERMAL_LIMIT   85    // Emergency drop temperature [C]
+#define EEEFSB_THERMAL_SLOPE   4     // Emergency drop temperature rise [C/s]
+#define EEEFSB_THERMAL_HYST    15    // Release when this far below the limit [C]
+//#define EEEFSB_TRACE               // Compile in the PLL/EC transaction recorder
+#define EEEFSB_BACKOFF_STEPS   6     // Lower the ceiling this many N units on a hardware error
+#define EEEFSB_BACKOFF_WINDOW  300   // Errors this long after a clock change count [s]
+#define EEEFSB_LOADGOV_UP      80    // Predicted load to ramp up at [%]
+#define EEEFSB_LOADGOV_DOWN    30    // Predicted load to ramp down at [%]
+#define EEEFSB_LOADGOV_DWELL   5000  // Minimum time between load governor retargets [ms]
@@ -29,13 +29,17 @@
  */
 #include <linux/kernel.h>
 #include <linux/module.h>
+#include <linux/mutex.h>
 #include <linux/i2c.h>
+#include <linux/platform_device.h>
+#include <linux/pm.h>
 #include "pll.h"
 #include "options.h"
+#include "eeefsb_trace.h"
 
 /* Prototypes */
 static void eeefsb_pll_read(void);
-static void eeefsb_pll_write(void);
+static int eeefsb_pll_write(void);
 
 static struct i2c_client eeefsb_pll_smbus_client = {
     .adapter = NULL,
@@ -45,18 +49,32 @@ static struct i2c_client eeefsb_pll_smbus_client = {
 
 static char eeefsb_pll_data[I2C_SMBUS_BLOCK_MAX];
 static int eeefsb_pll_datalen = 0;
+/* Serializes SMBus transfers and protects the cached control block */
+static DEFINE_MUTEX(eeefsb_pll_mutex);
 
 static void eeefsb_pll_read(void)
 {
     // Takes approx 150ms to execute.
+    int len;
+    u64 t = eeefsb_trace_clock();
+
     memset(eeefsb_pll_data, 0, I2C_SMBUS_BLOCK_MAX);
-    eeefsb_pll_datalen = i2c_smbus_read_block_data(&eeefsb_pll_smbus_client, 0, eeefsb_pll_data);
+    len = i2c_smbus_read_block_data(&eeefsb_pll_smbus_client, 0, eeefsb_pll_data);
+    eeefsb_pll_datalen = (len < 0) ? 0 : len;
+    eeefsb_trace_record(EEEFSB_TRACE_PLL_READ, 0, eeefsb_pll_data,
+                        eeefsb_pll_datalen, len, t);
 }
 
-static void eeefsb_pll_write(void)
+static int eeefsb_pll_write(void)
 {
     // Takes approx 150ms to execute ???
-    i2c_smbus_write_block_data(&eeefsb_pll_smbus_client, 0, eeefsb_pll_datalen, eeefsb_pll_data);
+    int retval;
+    u64 t = eeefsb_trace_clock();
+
+    retval = i2c_smbus_write_block_data(&eeefsb_pll_smbus_client, 0, eeefsb_pll_datalen, eeefsb_pll_data);
+    eeefsb_trace_record(EEEFSB_TRACE_PLL_WRITE, 0, eeefsb_pll_data,
+                        eeefsb_pll_datalen, retval, t);
+    return retval;
 }
 
 /*** FSB functions ************************************************************
@@ -66,7 +84,7 @@ static void eeefsb_pll_write(void)
  * PCID is the PCI and PCI-E divisor                                          *
  * f_PCIVCO = 24 * N/M                                                        *
  */
-void eeefsb_get_freq(int *cpuM, int *cpuN, int *PCID)
+static void eeefsb_get_freq_locked(int *cpuM, int *cpuN, int *PCID)
 {
     eeefsb_pll_read();
     *cpuM = eeefsb_pll_data[11] & 0x3F;
@@ -74,10 +92,19 @@ void eeefsb_get_freq(int *cpuM, int *cpuN, int *PCID)
     *PCID = eeefsb_pll_data[15] & 0x3F; // Byte 15: PCI M
 }
 
+void eeefsb_get_freq(int *cpuM, int *cpuN, int *PCID)
+{
+    mutex_lock(&eeefsb_pll_mutex);
+    eeefsb_get_freq_locked(cpuM, cpuN, PCID);
+    mutex_unlock(&eeefsb_pll_mutex);
+}
+
 void eeefsb_set_freq(int cpuM, int cpuN, int PCID)
 {
     int current_cpuM = 0, current_cpuN = 0, current_PCID = 0;
-    eeefsb_get_freq(&current_cpuM, &current_cpuN, &current_PCID);
+
+    mutex_lock(&eeefsb_pll_mutex);
+    eeefsb_get_freq_locked(&current_cpuM, &current_cpuN, &current_PCID);
     if (current_cpuM != cpuM || current_cpuN != cpuN || current_PCID != PCID)
     {
         eeefsb_pll_data[11] = ((cpuM & 0x3F) | ((cpuN & 0x03) << 6)) & 0xFF;
@@ -85,6 +112,34 @@ void eeefsb_set_freq(int cpuM, int cpuN, int PCID)
         eeefsb_pll_data[15] = PCID & 0x3F;
         eeefsb_pll_write();
     }
+    mutex_unlock(&eeefsb_pll_mutex);
+}
+
+/* PLL constant in 1/1000 units, refitted by eeefsb_calib.c from measurements */
+static int eeefsb_pll_const_milli = EEEFSB_PLL_CONST_MUL * 1000;
+
+int eeefsb_pll_get_const(void)
+{
+    return eeefsb_pll_const_milli;
+}
+
+void eeefsb_pll_set_const(int const_milli)
+{
+    eeefsb_pll_const_milli = const_milli;
+}
+
+/* CPU clock in MHz for the given M and N */
+int eeefsb_pll_to_mhz(int cpuM, int cpuN)
+{
+    if (cpuM <= 0)
+        return 0;
+    return (cpuN * eeefsb_pll_const_milli * EEEFSB_CPU_MUL) / (cpuM * 1000);
+}
+
+/* N giving the CPU clock closest to, but not above, mhz with the given M */
+int eeefsb_pll_to_n(int mhz, int cpuM)
+{
+    return (mhz * cpuM * 1000) / (eeefsb_pll_const_milli * EEEFSB_CPU_MUL);
 }
 
 int eeefsb_get_cpu_freq()
@@ -95,7 +150,258 @@ int eeefsb_get_cpu_freq()
 
     eeefsb_get_freq(&cpuM, &cpuN, &PCID);
     
-    return (cpuN * EEEFSB_PLL_CONST_MUL * EEEFSB_CPU_MUL) / cpuM;
+    return eeefsb_pll_to_mhz(cpuM, cpuN);
+}
+
+/*** Raw control block access **********************************************
+ * Byte-addressed window to the ICS9LPR426A SMBus control block, used by the *
+ * debugfs "pll" file. Reads refresh the cache from the chip first, writes   *
+ * patch the cache and push the whole block back in one transfer.           *
+ * Both return the number of bytes transferred or a negative errno.         *
+ */
+int eeefsb_pll_read_block(char *buf, int offset, int len)
+{
+    mutex_lock(&eeefsb_pll_mutex);
+    eeefsb_pll_read();
+    if (offset >= eeefsb_pll_datalen)
+        len = 0;
+    else if (offset + len > eeefsb_pll_datalen)
+        len = eeefsb_pll_datalen - offset;
+    if (len > 0)
+        memcpy(buf, eeefsb_pll_data + offset, len);
+    mutex_unlock(&eeefsb_pll_mutex);
+
+    return len;
+}
+
+int eeefsb_pll_write_block(const char *buf, int offset, int len)
+{
+    int retval;
+
+    mutex_lock(&eeefsb_pll_mutex);
+    eeefsb_pll_read();
+    if (eeefsb_pll_datalen == 0) {
+        retval = -EIO;
+        goto out;
+    }
+    if (offset >= eeefsb_pll_datalen) {
+        retval = -ENOSPC;
+        goto out;
+    }
+    if (offset + len > eeefsb_pll_datalen)
+        len = eeefsb_pll_datalen - offset;
+    memcpy(eeefsb_pll_data + offset, buf, len);
+    eeefsb_pll_write();
+    retval = len;
+out:
+    mutex_unlock(&eeefsb_pll_mutex);
+
+    return retval;
+}
+
+/*** Clock control ************************************************************
+ * ICS9LPR426A output enables and spread spectrum, see doc/9LPR426A.pdf.      *
+ * Every control is a single bit in the SMBus control block, set = enabled.   *
+ *                                                                            *
+ * The table below is the board description for the eee PC 901. Outputs       *
+ * flagged EEEFSB_CLK_GATE_SUSPEND are stopped during suspend-to-RAM from the *
+ * regular suspend callback of a platform device that is a child of the       *
+ * SMBus adapter, so the i801 controller is still up, and restarted from its  *
+ * resume callback. The CPU PLL has no spread enable of its own (CPU spread   *
+ * comes from the FS table in byte 0), so only PCI SSC is listed.             *
+ */
+#define EEEFSB_CLK_GATE_SUSPEND 0x01
+
+struct eeefsb_clk
+{
+    const char *name;
+    int byte;
+    unsigned char mask;
+    int flags;
+};
+
+static const struct eeefsb_clk eeefsb_pll_board[] = {
+    { "pci_ssc",   0,  0x40, 0 },   /* SS_EN2, PCI PLL spread enable  */
+    { "dot96",     1,  0x80, 0 },
+    { "usb48",     2,  0x80, EEEFSB_CLK_GATE_SUSPEND },
+    { "cpu2_itp",  2,  0x40, 0 },
+    { "sata",      2,  0x20, 0 },
+    { "ref1",      2,  0x10, 0 },
+    { "pci5",      2,  0x08, 0 },
+    { "pci4",      2,  0x04, 0 },
+    { "pci3",      2,  0x02, 0 },
+    { "pci2",      2,  0x01, 0 },
+    { "pci1",      3,  0x80, 0 },
+    { "pci0",      3,  0x40, 0 },
+    { "pciex5",    3,  0x20, 0 },
+    { "pciex4",    3,  0x10, 0 },
+    { "pciex3",    3,  0x02, 0 },
+    { "pciex2",    3,  0x01, 0 },
+    { "pciex1",    4,  0x80, 0 },
+    { "ref0",      4,  0x40, 0 },
+    { "pciex0",    4,  0x04, 0 },
+};
+#define EEEFSB_CLK_COUNT ((int)ARRAY_SIZE(eeefsb_pll_board))
+
+/* Controls gated by us for suspend, restored on resume */
+static unsigned long eeefsb_pll_suspend_gated;
+static struct platform_device *eeefsb_pll_pdev;
+
+int eeefsb_pll_clk_count(void)
+{
+    return EEEFSB_CLK_COUNT;
+}
+
+const char *eeefsb_pll_clk_name(int id)
+{
+    if (id < 0 || id >= EEEFSB_CLK_COUNT)
+        return NULL;
+    return eeefsb_pll_board[id].name;
+}
+
+int eeefsb_pll_clk_lookup(const char *name)
+{
+    int i;
+
+    for (i = 0; i < EEEFSB_CLK_COUNT; i++)
+        if (strcmp(eeefsb_pll_board[i].name, name) == 0)
+            return i;
+    return -ENOENT;
+}
+
+/* Returns 1 if enabled, 0 if disabled or a negative errno */
+int eeefsb_pll_clk_get(int id)
+{
+    const struct eeefsb_clk *clk;
+    int retval;
+
+    if (id < 0 || id >= EEEFSB_CLK_COUNT)
+        return -EINVAL;
+    clk = &eeefsb_pll_board[id];
+
+    mutex_lock(&eeefsb_pll_mutex);
+    eeefsb_pll_read();
+    if (clk->byte >= eeefsb_pll_datalen)
+        retval = -ENODEV;
+    else
+        retval = (eeefsb_pll_data[clk->byte] & clk->mask) ? 1 : 0;
+    mutex_unlock(&eeefsb_pll_mutex);
+
+    return retval;
+}
+
+int eeefsb_pll_clk_set(int id, int enable)
+{
+    const struct eeefsb_clk *clk;
+    char old;
+    int retval = 0;
+
+    if (id < 0 || id >= EEEFSB_CLK_COUNT)
+        return -EINVAL;
+    clk = &eeefsb_pll_board[id];
+
+    mutex_lock(&eeefsb_pll_mutex);
+    eeefsb_pll_read();
+    if (clk->byte >= eeefsb_pll_datalen) {
+        mutex_unlock(&eeefsb_pll_mutex);
+        return -ENODEV;
+    }
+    old = eeefsb_pll_data[clk->byte];
+    if (enable)
+        eeefsb_pll_data[clk->byte] |= clk->mask;
+    else
+        eeefsb_pll_data[clk->byte] &= ~clk->mask;
+    if (eeefsb_pll_data[clk->byte] != old && eeefsb_pll_write() < 0) {
+        eeefsb_pll_data[clk->byte] = old;
+        retval = -EIO;
+    }
+    mutex_unlock(&eeefsb_pll_mutex);
+
+    return retval;
+}
+
+/* Stop the enabled outputs with the given flag and remember them */
+static void eeefsb_pll_gate(int flag)
+{
+    int i;
+
+    for (i = 0; i < EEEFSB_CLK_COUNT; i++) {
+        if (!(eeefsb_pll_board[i].flags & flag))
+            continue;
+        if (eeefsb_pll_clk_get(i) == 1 && eeefsb_pll_clk_set(i, 0) == 0)
+            eeefsb_pll_suspend_gated |= 1UL << i;
+    }
+}
+
+/* Restart the outputs with the given flag that we stopped */
+static void eeefsb_pll_ungate(int flag)
+{
+    int i;
+
+    /* The chip may have been reset already, this is harmless then */
+    for (i = 0; i < EEEFSB_CLK_COUNT; i++) {
+        if (!(eeefsb_pll_board[i].flags & flag) ||
+            !(eeefsb_pll_suspend_gated & (1UL << i)))
+            continue;
+        if (eeefsb_pll_clk_set(i, 1) < 0) {
+            /* Keep it marked, the next resume tries again */
+            printk(KERN_WARNING "eeefsb: Failed to restart clock %s\n",
+                   eeefsb_pll_board[i].name);
+            continue;
+        }
+        eeefsb_pll_suspend_gated &= ~(1UL << i);
+    }
+}
+
+static int eeefsb_pll_suspend(struct device *dev)
+{
+    eeefsb_pll_gate(EEEFSB_CLK_GATE_SUSPEND);
+    return 0;
+}
+
+static int eeefsb_pll_resume(struct device *dev)
+{
+    eeefsb_pll_ungate(EEEFSB_CLK_GATE_SUSPEND);
+    return 0;
+}
+
+static const struct dev_pm_ops eeefsb_pll_pm_ops = {
+    .suspend = eeefsb_pll_suspend,
+    .resume  = eeefsb_pll_resume,
+};
+
+static struct platform_driver eeefsb_pll_driver = {
+    .driver = {
+        .name  = "eeefsb_pll",
+        .owner = THIS_MODULE,
+        .pm    = &eeefsb_pll_pm_ops,
+    },
+};
+
+/*
+ * A device for the suspend gating. As a child of the SMBus adapter it
+ * suspends before and resumes after the i801 controller, so the bus is
+ * still up in both callbacks.
+ */
+static void eeefsb_pll_pm_init(void)
+{
+    if (platform_driver_register(&eeefsb_pll_driver))
+        goto fail;
+    eeefsb_pll_pdev = platform_device_alloc("eeefsb_pll", -1);
+    if (!eeefsb_pll_pdev)
+        goto fail_driver;
+    eeefsb_pll_pdev->dev.parent = &eeefsb_pll_smbus_client.adapter->dev;
+    if (platform_device_add(eeefsb_pll_pdev))
+        goto fail_put;
+    return;
+
+fail_put:
+    platform_device_put(eeefsb_pll_pdev);
+    eeefsb_pll_pdev = NULL;
+fail_driver:
+    platform_driver_unregister(&eeefsb_pll_driver);
+fail:
+    printk(KERN_WARNING "eeefsb: No PM device, USB clock won't be gated in suspend\n");
 }
 
 int eeefsb_pll_init(void)
@@ -121,12 +427,21 @@ int eeefsb_pll_init(void)
     }
 
     /* Fill the eeefsb_pll_data buffer. */
+    mutex_lock(&eeefsb_pll_mutex);
     eeefsb_pll_read();
+    mutex_unlock(&eeefsb_pll_mutex);
+
+    eeefsb_pll_pm_init();
     
     return 0;
 }
 
 void eeefsb_pll_cleanup(void)
 {
+    if (eeefsb_pll_pdev) {
+        platform_device_unregister(eeefsb_pll_pdev);
+        platform_driver_unregister(&eeefsb_pll_driver);
+        eeefsb_pll_pdev = NULL;
+    }
     i2c_put_adapter(eeefsb_pll_smbus_client.adapter);
 }
@@ -34,6 +34,17 @@
 void eeefsb_get_freq(int *cpuM, int *cpuN, int *PCID);
 void eeefsb_set_freq(int cpuM, int cpuN, int PCID);
 int eeefsb_get_cpu_freq(void);
+int eeefsb_pll_get_const(void);
+void eeefsb_pll_set_const(int const_milli);
+int eeefsb_pll_to_mhz(int cpuM, int cpuN);
+int eeefsb_pll_to_n(int mhz, int cpuM);
+int eeefsb_pll_read_block(char *buf, int offset, int len);
+int eeefsb_pll_write_block(const char *buf, int offset, int len);
+int eeefsb_pll_clk_count(void);
+const char *eeefsb_pll_clk_name(int id);
+int eeefsb_pll_clk_lookup(const char *name);
+int eeefsb_pll_clk_get(int id);
+int eeefsb_pll_clk_set(int id, int enable);
 int eeefsb_pll_init(void);
 void eeefsb_pll_cleanup(void);
 #endif
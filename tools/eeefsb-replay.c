@@ -0,0 +1,270 @@
+/*
+ *  eeefsb-replay.c - offline analysis of eeefsb PLL/EC transaction traces
+ *
+ *  Copyright (C) 2012 Olli Vanhoja
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  Ths program is distributed in the hope that it will be useful,
+ *  but WITOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTAILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Template Place, Suite 330, Boston, MA  02111-1307 USA
+ *  
+ *  ---------
+ *
+ *  This code comes WITHOUT ANY WARRANTY whatsoever.
+ */
+
+/*** Trace replay *************************************************************
+ * Reads a dump of /sys/kernel/debug/eeefsb/trace and replays it against a    *
+ * fake PLL and EC. Only the planner of the module is run offline, the rest   *
+ * of the policy code (stepper, thermal watchdog, governors) is not, so this  *
+ * checks the recorded traffic and the ramps rather than re-running a field   *
+ * problem:                                                                   *
+ * - writes update the fake hardware, reads are checked against it and a     *
+ *   mismatch is reported (the chip didn't take a write or the EC firmware    *
+ *   changed something behind our back)                                       *
+ * - per transaction type counts and durations are summarized                 *
+ * - PLL writes are grouped into ramps, and every ramp is replanned with the  *
+ *   planner of the module (module/eeefsb_plan.c) to compare the recorded     *
+ *   writes and time against what the current code would do                   *
+ *                                                                            *
+ * Usage: eeefsb-replay [-z HZ] [-c PLL constant] [-v] trace.bin              *
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "options.h"
+#include "eeefsb_plan.h"
+#include "eeefsb_trace.h"
+
+#define RAMP_GAP_NS 5000000000ULL   /* Writes further apart start a new ramp */
+#define NR_TYPES    5
+
+struct fake_hw
+{
+    unsigned char pll[EEEFSB_TRACE_DATA];
+    int pll_len;
+    unsigned char ec[0x10000];
+    unsigned char ec_known[0x10000];
+};
+
+struct type_stats
+{
+    unsigned long count;
+    unsigned long errors;
+    unsigned long mismatches;
+    unsigned long long total_ns;
+    unsigned long max_ns;
+};
+
+static const char *type_names[NR_TYPES] = {
+    "?", "pll_read", "pll_write", "ec_read", "ec_write"
+};
+
+static struct fake_hw hw;
+static struct type_stats stats[NR_TYPES];
+static int hz = 250;
+static int const_milli = EEEFSB_PLL_CONST_MUL * 1000;
+static int verbose = 0;
+
+static void pll_decode(const unsigned char *pll, struct eeefsb_waypoint *wp)
+{
+    wp->m = pll[11] & 0x3F;
+    wp->n = ((int)pll[12] << 2) | ((pll[11] & 0xC0) >> 6);
+    wp->pcid = pll[15] & 0x3F;
+    wp->voltage = 0;
+}
+
+/* Apply one record to the fake hardware, returns 1 on a read mismatch */
+static int replay_rec(const struct eeefsb_trace_rec *rec)
+{
+    int len = (rec->len < EEEFSB_TRACE_DATA) ? rec->len : EEEFSB_TRACE_DATA;
+    int mismatch = 0;
+    int i;
+
+    switch (rec->type) {
+    case EEEFSB_TRACE_PLL_READ:
+        if (hw.pll_len > 0 && (hw.pll_len != len || memcmp(hw.pll, rec->data, len)))
+            mismatch = 1;
+        /* The chip is the truth */
+        /* fall through */
+    case EEEFSB_TRACE_PLL_WRITE:
+        memcpy(hw.pll, rec->data, len);
+        hw.pll_len = len;
+        break;
+    case EEEFSB_TRACE_EC_READ:
+        for (i = 0; i < len; i++) {
+            unsigned short a = rec->addr + i;
+
+            if (hw.ec_known[a] && hw.ec[a] != rec->data[i])
+                mismatch = 1;
+            hw.ec[a] = rec->data[i];
+            hw.ec_known[a] = 1;
+        }
+        break;
+    case EEEFSB_TRACE_EC_WRITE:
+        for (i = 0; i < len; i++) {
+            unsigned short a = rec->addr + i;
+
+            hw.ec[a] = rec->data[i];
+            hw.ec_known[a] = 1;
+        }
+        break;
+    }
+
+    return mismatch;
+}
+
+/* Replan a recorded ramp with the planner of the module and compare */
+static void ramp_report(int idx, const struct eeefsb_waypoint *from,
+                        const struct eeefsb_waypoint *to, int writes,
+                        unsigned long long dur_ns, unsigned long long bus_ns)
+{
+    static struct eeefsb_plan plan;
+    unsigned long long step_ns = (unsigned long long)EEEFSB_STEPDELAY * 1000000000ULL / hz;
+    unsigned long long avg_write = writes ? bus_ns / writes : 0;
+    unsigned long long est_ns;
+
+    if (eeefsb_plan_build(&plan, from, to->m, to->n, const_milli)) {
+        printf("%3d  %2d/%-3d -> %2d/%-3d  %5d %9.2f   (unplannable)\n", idx,
+               from->m, from->n, to->m, to->n, writes, dur_ns / 1e9);
+        return;
+    }
+    est_ns = plan.len * (step_ns + avg_write);
+    printf("%3d  %2d/%-3d -> %2d/%-3d  %5d %9.2f  %5d %9.2f\n", idx,
+           from->m, from->n, to->m, to->n, writes, dur_ns / 1e9,
+           plan.len, est_ns / 1e9);
+}
+
+static void usage(const char *prog)
+{
+    fprintf(stderr, "Usage: %s [-z HZ] [-c PLL constant] [-v] trace.bin\n"
+            "  -z  kernel HZ the trace was recorded with (default %d)\n"
+            "  -c  PLL constant used for replanning (default %d.%03d)\n"
+            "  -v  print every record\n", prog, hz, const_milli / 1000, const_milli % 1000);
+    exit(1);
+}
+
+int main(int argc, char *argv[])
+{
+    struct eeefsb_trace_rec *recs = NULL;
+    struct eeefsb_waypoint cur, ramp_from, ramp_to;
+    unsigned long long ramp_start = 0, ramp_last = 0, ramp_bus = 0;
+    unsigned long n = 0, cap = 0, i;
+    int have_cur = 0, ramp_writes = 0, ramps = 0;
+    FILE *f;
+    int opt, t;
+
+    while ((opt = getopt(argc, argv, "z:c:v")) != -1) {
+        switch (opt) {
+        case 'z': hz = atoi(optarg); break;
+        case 'c': const_milli = (int)(atof(optarg) * 1000); break;
+        case 'v': verbose = 1; break;
+        default: usage(argv[0]);
+        }
+    }
+    if (optind >= argc || hz <= 0 || const_milli <= 0)
+        usage(argv[0]);
+
+    f = fopen(argv[optind], "rb");
+    if (!f) {
+        perror(argv[optind]);
+        return 1;
+    }
+    for (;;) {
+        if (n == cap) {
+            cap = cap ? cap * 2 : 1024;
+            recs = realloc(recs, cap * sizeof(*recs));
+            if (!recs) {
+                perror("realloc");
+                return 1;
+            }
+        }
+        if (fread(&recs[n], sizeof(*recs), 1, f) != 1)
+            break;
+        n++;
+    }
+    fclose(f);
+    if (n == 0) {
+        fprintf(stderr, "%s: no records\n", argv[optind]);
+        return 1;
+    }
+
+    memset(&cur, 0, sizeof(cur));
+    printf("# ramp  from -> to      recorded: writes  time[s]  planned: writes  time[s]\n");
+    for (i = 0; i < n; i++) {
+        const struct eeefsb_trace_rec *rec = &recs[i];
+
+        t = (rec->type < NR_TYPES) ? rec->type : 0;
+
+        stats[t].count++;
+        stats[t].total_ns += rec->dur_ns;
+        if (rec->dur_ns > stats[t].max_ns)
+            stats[t].max_ns = rec->dur_ns;
+        if (rec->result < 0)
+            stats[t].errors++;
+        if (replay_rec(rec)) {
+            stats[t].mismatches++;
+            if (verbose)
+                printf("#   mismatch on %s at 0x%04x\n", type_names[t], rec->addr);
+        }
+        if (verbose)
+            printf("# %llu.%09llu %-9s addr 0x%04x len %u result %d %u ns\n",
+                   (unsigned long long)rec->ts_ns / 1000000000ULL,
+                   (unsigned long long)rec->ts_ns % 1000000000ULL,
+                   type_names[t], rec->addr, rec->len, rec->result, rec->dur_ns);
+
+        if (rec->type != EEEFSB_TRACE_PLL_READ && rec->type != EEEFSB_TRACE_PLL_WRITE)
+            continue;
+        if (rec->len < 16)
+            continue;
+
+        if (rec->type == EEEFSB_TRACE_PLL_WRITE) {
+            if (ramp_writes > 0 && rec->ts_ns - ramp_last > RAMP_GAP_NS) {
+                ramp_report(++ramps, &ramp_from, &ramp_to, ramp_writes,
+                            ramp_last - ramp_start, ramp_bus);
+                ramp_writes = 0;
+            }
+            if (ramp_writes == 0) {
+                if (have_cur)
+                    ramp_from = cur;
+                else
+                    pll_decode(rec->data, &ramp_from);
+                ramp_start = rec->ts_ns;
+                ramp_bus = 0;
+            }
+            ramp_writes++;
+            ramp_last = rec->ts_ns + rec->dur_ns;
+            ramp_bus += rec->dur_ns;
+            pll_decode(rec->data, &ramp_to);
+        }
+        pll_decode(rec->data, &cur);
+        have_cur = 1;
+    }
+    if (ramp_writes > 0)
+        ramp_report(++ramps, &ramp_from, &ramp_to, ramp_writes,
+                    ramp_last - ramp_start, ramp_bus);
+
+    printf("# %lu records over %.3f s\n", n,
+           (recs[n - 1].ts_ns - recs[0].ts_ns) / 1e9);
+    printf("# type       count  errors  mismatches   avg[us]   max[us]\n");
+    for (t = 1; t < NR_TYPES; t++) {
+        if (stats[t].count == 0)
+            continue;
+        printf("# %-9s %6lu  %6lu  %10lu  %8.1f  %8.1f\n", type_names[t],
+               stats[t].count, stats[t].errors, stats[t].mismatches,
+               stats[t].total_ns / 1e3 / stats[t].count, stats[t].max_ns / 1e3);
+    }
+
+    free(recs);
+    return 0;
+}
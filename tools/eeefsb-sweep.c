@@ -0,0 +1,697 @@
+/*
+ *  eeefsb-sweep.c - performance per watt sweep over the CPU clock range
+ *
+ *  Copyright (C) 2012 Olli Vanhoja
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  Ths program is distributed in the hope that it will be useful,
+ *  but WITOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTAILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Template Place, Suite 330, Boston, MA  02111-1307 USA
+ *  
+ *  ---------
+ *
+ *  This code comes WITHOUT ANY WARRANTY whatsoever.
+ */
+
+/*** Operating point sweep ****************************************************
+ * Steps the CPU clock through the range the module can reach and measures    *
+ * every point:                                                               *
+ * - sets the clock through /proc/eeefsb/cpu_freq and waits until ramp_plan   *
+ *   reports the ramp done                                                    *
+ * - keeps the CPU loaded until the temperature is stable (the last -w        *
+ *   samples, one per second, within -T degrees) or -m seconds have passed    *
+ * - runs an integer, a memory bandwidth and a memory latency benchmark       *
+ * - prints a CSV (or JSON with -j) line with the scores, the steady state    *
+ *   temperature, fan duty and rpm and, when running on battery, the          *
+ *   discharge rate                                                           *
+ * The original clock is restored at the end or on SIGINT. Timing relies on   *
+ * CLOCK_MONOTONIC, which the module keeps off the TSC once it changes the    *
+ * clock.                                                                     *
+ *                                                                            *
+ * A governor in the module (memgov, loadgov) would retarget the clock under  *
+ * the sweep, so the sweep refuses to run while one is enabled, or with -G    *
+ * turns them off for the duration and back on at the end.                    *
+ *                                                                            *
+ * With -S the module and the hardware are replaced by a simple thermal and   *
+ * performance model running on virtual time, to test the harness itself.     *
+ *                                                                            *
+ * Usage: eeefsb-sweep [-S] [-G] [-j] [-f from] [-t to] [-d step]             *
+ *                     [-w samples] [-T tolerance] [-m max wait]              *
+ *                     [-l bench s] [-a abort C] [-c PLL constant]            *
+ *                     [-p proc dir] [-B battery dir]                         *
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <signal.h>
+#include <math.h>
+#include <time.h>
+#include "options.h"
+#include "eeefsb_plan.h"
+
+#define BENCH_INT     0
+#define BENCH_MEM     1
+#define BENCH_LAT     2
+#define NR_BENCH      3
+#define MEM_BYTES     (8 << 20)     /* Well past the 512 KB L2 of the N270 */
+#define LINE_BYTES    64
+#define NR_GOVERNORS  2
+
+/* Where the numbers come from, the module on real hardware or the model */
+struct backend
+{
+    const char *name;
+    int (*set_freq)(int mhz);
+    int (*settled)(void);           /* 1 once the ramp is done */
+    int (*read_freq)(void);         /* [MHz] */
+    int (*read_temp)(void);         /* [C] */
+    int (*read_fan_duty)(void);     /* [%] */
+    int (*read_fan_rpm)(void);
+    int (*read_power)(void);        /* Battery discharge [mW], -1 if unknown */
+    void (*idle)(double sec);
+    void (*load)(double sec);       /* Keep the CPU busy for sec */
+    double (*bench)(int kind, double sec);
+    int (*governors)(int off);      /* Mask of enabled ones, off turns them off */
+    void (*restore_governors)(int mask);
+};
+
+struct point
+{
+    int target;
+    int mhz;
+    double score[NR_BENCH];
+    double temp;
+    double fan_duty;
+    double fan_rpm;
+    double power;                   /* [mW], < 0 if unknown */
+    double settle;                  /* Ramp and warm up time [s] */
+    int stable;
+};
+
+static const char *bench_names[NR_BENCH] = { "int_mops", "mem_mbps", "lat_ns" };
+static const char *governor_names[NR_GOVERNORS] = { "memgov", "loadgov" };
+
+static char proc_dir[256] = "/proc/eeefsb";
+static char bat_dir[256] = "/sys/class/power_supply/BAT0";
+static int const_milli = EEEFSB_PLL_CONST_MUL * 1000;
+static volatile sig_atomic_t stop = 0;
+
+/*** Helpers ******************************************************************/
+static double now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static int read_int(const char *dir, const char *file, long *val)
+{
+    char path[512];
+    FILE *f;
+    int ret;
+
+    snprintf(path, sizeof(path), "%s/%s", dir, file);
+    f = fopen(path, "r");
+    if (!f)
+        return -1;
+    ret = (fscanf(f, "%ld", val) == 1) ? 0 : -1;
+    fclose(f);
+
+    return ret;
+}
+
+static int mhz_of(int m, int n)
+{
+    return (int)((long)n * const_milli * EEEFSB_CPU_MUL / (m * 1000L));
+}
+
+/*** Benchmarks ***************************************************************/
+static unsigned char *mem_src, *mem_dst;
+static size_t *chase;
+static volatile unsigned long sink;
+
+/* Integer ALU mix, [M loop iterations/s] */
+static double bench_int(double sec)
+{
+    unsigned long x = 88172645463325252UL, acc = 0, iters = 0;
+    double t0 = now(), t;
+    int i;
+
+    do {
+        for (i = 0; i < 65536; i++) {
+            x ^= x << 13;
+            x ^= x >> 7;
+            x ^= x << 17;
+            acc += (x * 2654435761UL) / ((x & 0xff) | 1);
+        }
+        iters += 65536;
+        t = now() - t0;
+    } while (t < sec && !stop);
+    sink = acc;
+
+    return iters / t / 1e6;
+}
+
+/* Copy bandwidth, bytes read plus written [MB/s] */
+static double bench_mem(double sec)
+{
+    unsigned long bytes = 0;
+    double t0 = now(), t;
+
+    do {
+        memcpy(mem_dst, mem_src, MEM_BYTES);
+        bytes += 2UL * MEM_BYTES;
+        t = now() - t0;
+    } while (t < sec && !stop);
+    sink = mem_dst[bytes & (MEM_BYTES - 1)];
+
+    return bytes / t / 1e6;
+}
+
+/* Dependent loads over a random cycle of cache lines [ns/load] */
+static double bench_lat(double sec)
+{
+    size_t p = 0;
+    unsigned long loads = 0;
+    double t0 = now(), t;
+    int i;
+
+    do {
+        for (i = 0; i < 65536; i++)
+            p = chase[p];
+        loads += 65536;
+        t = now() - t0;
+    } while (t < sec && !stop);
+    sink = p;
+
+    return t * 1e9 / loads;
+}
+
+static int bench_setup(void)
+{
+    size_t lines = MEM_BYTES / LINE_BYTES;
+    size_t stride = LINE_BYTES / sizeof(size_t);
+    size_t *order;
+    size_t i, j, tmp;
+
+    mem_src = malloc(MEM_BYTES);
+    mem_dst = malloc(MEM_BYTES);
+    chase = malloc(MEM_BYTES);
+    order = malloc(lines * sizeof(*order));
+    if (!mem_src || !mem_dst || !chase || !order)
+        return -1;
+    memset(mem_src, 0x5a, MEM_BYTES);
+    memset(mem_dst, 0, MEM_BYTES);
+
+    /* Sattolo's shuffle gives a single cycle through every line */
+    for (i = 0; i < lines; i++)
+        order[i] = i;
+    srand(1);
+    for (i = lines - 1; i > 0; i--) {
+        j = (size_t)rand() % i;
+        tmp = order[i];
+        order[i] = order[j];
+        order[j] = tmp;
+    }
+    for (i = 0; i < lines; i++)
+        chase[order[i] * stride] = order[(i + 1) % lines] * stride;
+    free(order);
+
+    return 0;
+}
+
+/*** procfs backend, the real thing *******************************************/
+static int proc_set_freq(int mhz)
+{
+    char path[512];
+    FILE *f;
+
+    snprintf(path, sizeof(path), "%s/cpu_freq", proc_dir);
+    f = fopen(path, "w");
+    if (!f)
+        return -1;
+    fprintf(f, "%d\n", mhz);
+    return fclose(f);
+}
+
+static int proc_settled(void)
+{
+    char path[512], line[128];
+    int pos = 0, len = -1;
+    FILE *f;
+
+    snprintf(path, sizeof(path), "%s/ramp_plan", proc_dir);
+    f = fopen(path, "r");
+    if (!f)
+        return 1; /* Older module without ramp_plan, cpu_freq has to do */
+    if (fgets(line, sizeof(line), f)) {
+        char *p = strchr(line, '(');
+
+        if (p)
+            sscanf(p, "(%d of %d", &pos, &len);
+    }
+    fclose(f);
+
+    return pos >= len;
+}
+
+static int proc_read(const char *file)
+{
+    long v;
+
+    return read_int(proc_dir, file, &v) ? -1 : (int)v;
+}
+
+static int proc_read_freq(void)     { return proc_read("cpu_freq"); }
+static int proc_read_temp(void)     { return proc_read("temperature"); }
+static int proc_read_fan_duty(void) { return proc_read("fan_speed"); }
+static int proc_read_fan_rpm(void)  { return proc_read("fan_rpm"); }
+
+static int proc_read_power(void)
+{
+    char path[512], status[32] = "";
+    long power, current, voltage;
+    FILE *f;
+
+    snprintf(path, sizeof(path), "%s/status", bat_dir);
+    f = fopen(path, "r");
+    if (!f)
+        return -1;
+    if (fscanf(f, "%31s", status) != 1)
+        status[0] = '\0';
+    fclose(f);
+    if (strcmp(status, "Discharging") != 0)
+        return -1;
+
+    if (read_int(bat_dir, "power_now", &power) == 0)
+        return (int)(power / 1000);
+    if (read_int(bat_dir, "current_now", &current) == 0 &&
+        read_int(bat_dir, "voltage_now", &voltage) == 0)
+        return (int)((double)current * voltage / 1e9);
+
+    return -1;
+}
+
+static void proc_idle(double sec)
+{
+    struct timespec ts;
+
+    ts.tv_sec = (time_t)sec;
+    ts.tv_nsec = (long)((sec - ts.tv_sec) * 1e9);
+    nanosleep(&ts, NULL);
+}
+
+static void proc_load(double sec)
+{
+    bench_int(sec);
+}
+
+static double proc_bench(int kind, double sec)
+{
+    switch (kind) {
+    case BENCH_INT: return bench_int(sec);
+    case BENCH_MEM: return bench_mem(sec);
+    default:        return bench_lat(sec);
+    }
+}
+
+static int proc_write_enabled(const char *file, int enabled)
+{
+    char path[512];
+    FILE *f;
+
+    snprintf(path, sizeof(path), "%s/%s", proc_dir, file);
+    f = fopen(path, "w");
+    if (!f)
+        return -1;
+    fprintf(f, "%d\n", enabled);
+    return fclose(f);
+}
+
+static int proc_governors(int off)
+{
+    int i, mask = 0;
+
+    for (i = 0; i < NR_GOVERNORS; i++) {
+        if (proc_read(governor_names[i]) <= 0)
+            continue;
+        mask |= 1 << i;
+        if (off && proc_write_enabled(governor_names[i], 0))
+            perror(governor_names[i]);
+    }
+
+    return mask;
+}
+
+static void proc_restore_governors(int mask)
+{
+    int i;
+
+    /* They exclude each other, so only one of them can come back on */
+    for (i = 0; i < NR_GOVERNORS; i++)
+        if (mask & (1 << i))
+            proc_write_enabled(governor_names[i], 1);
+}
+
+static const struct backend proc_backend = {
+    "procfs", proc_set_freq, proc_settled, proc_read_freq, proc_read_temp,
+    proc_read_fan_duty, proc_read_fan_rpm, proc_read_power, proc_idle,
+    proc_load, proc_bench, proc_governors, proc_restore_governors
+};
+
+/*** Simulated backend ********************************************************
+ * First order thermal model on virtual time. Power grows with the square of  *
+ * the clock plus a voltage step, the fan follows the temperature like the    *
+ * EC does and lowers the thermal resistance. The ramp moves like the module  *
+ * would, one waypoint per EEEFSB_STEPDELAY at HZ = 250.                      *
+ */
+#define SIM_DT       0.1
+#define SIM_AMBIENT  30.0
+#define SIM_TAU      40.0           /* Thermal time constant [s] */
+#define SIM_STEP_S   (EEEFSB_STEPDELAY / 250.0)
+#define SIM_STEP_MHZ 12
+
+static struct
+{
+    int freq, target;
+    double temp, step_left;
+    int busy;
+} sim = { 1200, 1200, 45.0, 0, 0 };
+
+static double sim_power(void)
+{
+    double f = sim.freq / 1000.0;
+    double v = (sim.freq >= EEEFSB_HIVOLTFREQ) ? 1.15 : 1.0;
+
+    return 4.0 + (sim.busy ? 1.6 : 0.4) * v * v * f * f; /* [W] */
+}
+
+static int sim_read_fan_duty(void)
+{
+    if (sim.temp < 55.0)
+        return 0;
+    return (sim.temp > 80.0) ? 100 : (int)((sim.temp - 55.0) * 4);
+}
+
+static void sim_advance(double sec, int busy)
+{
+    double t, rth;
+
+    sim.busy = busy;
+    for (t = 0; t < sec; t += SIM_DT) {
+        if (sim.freq != sim.target) {
+            sim.step_left -= SIM_DT;
+            if (sim.step_left <= 0) {
+                if (abs(sim.target - sim.freq) <= SIM_STEP_MHZ)
+                    sim.freq = sim.target;
+                else
+                    sim.freq += (sim.target > sim.freq) ? SIM_STEP_MHZ : -SIM_STEP_MHZ;
+                sim.step_left = SIM_STEP_S;
+            }
+        }
+        rth = 9.0 - 5.0 * sim_read_fan_duty() / 100.0; /* [K/W] */
+        sim.temp += (SIM_AMBIENT + sim_power() * rth - sim.temp) * SIM_DT / SIM_TAU;
+    }
+}
+
+static int sim_set_freq(int mhz)
+{
+    sim.target = mhz;
+    sim.step_left = SIM_STEP_S;
+    return 0;
+}
+
+static int sim_settled(void)        { return sim.freq == sim.target; }
+static int sim_read_freq(void)      { return sim.freq; }
+static int sim_read_temp(void)      { return (int)sim.temp; }
+static int sim_read_fan_rpm(void)   { return sim_read_fan_duty() * 45; }
+static int sim_read_power(void)     { return (int)(sim_power() * 1000); }
+static void sim_idle(double sec)    { sim_advance(sec, 0); }
+static void sim_load(double sec)    { sim_advance(sec, 1); }
+
+static double sim_bench(int kind, double sec)
+{
+    double f = sim.freq;
+
+    sim_advance(sec, 1);
+    switch (kind) {
+    case BENCH_INT: return f * 0.9;
+    case BENCH_MEM: return (f * 1.7 < 2600.0) ? f * 1.7 : 2600.0;
+    default:        return 70.0 + 60000.0 / f;
+    }
+}
+
+static int sim_governors(int off)
+{
+    (void)off;
+    return 0;
+}
+
+static void sim_restore_governors(int mask)
+{
+    (void)mask;
+}
+
+static const struct backend sim_backend = {
+    "sim", sim_set_freq, sim_settled, sim_read_freq, sim_read_temp,
+    sim_read_fan_duty, sim_read_fan_rpm, sim_read_power, sim_idle,
+    sim_load, sim_bench, sim_governors, sim_restore_governors
+};
+
+/*** Sweep ********************************************************************/
+static int window = 30;             /* Samples that must agree [1/s] */
+static double tolerance = 1.0;      /* [C] */
+static double max_wait = 600;       /* [s] */
+static double bench_sec = 5;
+static int abort_temp = EEEFSB_THERMAL_LIMIT - 5;
+
+/* Geometric mean of the three, latency inverted, higher is better */
+static double composite(const struct point *p)
+{
+    return cbrt(p->score[BENCH_INT] * p->score[BENCH_MEM] *
+                (1000.0 / p->score[BENCH_LAT]));
+}
+
+static int measure(const struct backend *be, int target, struct point *p)
+{
+    double temps[window], fans[window], rpms[window], powers[window];
+    double waited = 0, lo, hi;
+    int i, k, n = 0, npower;
+
+    memset(p, 0, sizeof(*p));
+    p->target = target;
+    if (be->set_freq(target)) {
+        perror("cpu_freq");
+        return -1;
+    }
+    while (!be->settled() && waited < max_wait && !stop) {
+        be->idle(0.5);
+        waited += 0.5;
+    }
+
+    /* Warm up under load until the temperature stops moving */
+    while (waited < max_wait && !stop) {
+        be->load(1.0);
+        waited += 1.0;
+        k = n++ % window;
+        temps[k] = be->read_temp();
+        fans[k] = be->read_fan_duty();
+        rpms[k] = be->read_fan_rpm();
+        powers[k] = be->read_power();
+        if (temps[k] >= abort_temp) {
+            fprintf(stderr, "%d MHz: %.0f C, giving up on higher clocks\n",
+                    target, temps[k]);
+            return 1;
+        }
+        if (n < window)
+            continue;
+        lo = hi = temps[0];
+        for (i = 1; i < window; i++) {
+            lo = (temps[i] < lo) ? temps[i] : lo;
+            hi = (temps[i] > hi) ? temps[i] : hi;
+        }
+        if (hi - lo <= tolerance) {
+            p->stable = 1;
+            break;
+        }
+    }
+    if (stop)
+        return -1;
+
+    if (n > window)
+        n = window;
+    npower = 0;
+    p->power = 0;
+    for (i = 0; i < n; i++) {
+        p->temp += temps[i] / n;
+        p->fan_duty += fans[i] / n;
+        p->fan_rpm += rpms[i] / n;
+        if (powers[i] >= 0) {
+            p->power += powers[i];
+            npower++;
+        }
+    }
+    p->power = npower ? p->power / npower : -1;
+    p->settle = waited;
+    p->mhz = be->read_freq();
+    for (k = 0; k < NR_BENCH; k++)
+        p->score[k] = be->bench(k, bench_sec);
+
+    return 0;
+}
+
+static void print_point(const struct point *p, int json, int first)
+{
+    double score = composite(p);
+
+    if (json) {
+        printf("%s\n  {\"target\": %d, \"mhz\": %d, \"%s\": %.1f, \"%s\": %.1f, "
+               "\"%s\": %.2f, \"score\": %.2f, \"temp_c\": %.1f, \"fan_duty\": %.1f, "
+               "\"fan_rpm\": %.0f, ", first ? "" : ",", p->target, p->mhz,
+               bench_names[0], p->score[0], bench_names[1], p->score[1],
+               bench_names[2], p->score[2], score, p->temp, p->fan_duty, p->fan_rpm);
+        if (p->power >= 0)
+            printf("\"power_mw\": %.0f, \"score_per_w\": %.2f, ", p->power,
+                   score * 1000.0 / p->power);
+        else
+            printf("\"power_mw\": null, \"score_per_w\": null, ");
+        printf("\"settle_s\": %.1f, \"stable\": %s}", p->settle,
+               p->stable ? "true" : "false");
+    } else {
+        printf("%d,%d,%.1f,%.1f,%.2f,%.2f,%.1f,%.1f,%.0f,", p->target, p->mhz,
+               p->score[0], p->score[1], p->score[2], score, p->temp,
+               p->fan_duty, p->fan_rpm);
+        if (p->power >= 0)
+            printf("%.0f,%.2f,", p->power, score * 1000.0 / p->power);
+        else
+            printf(",,");
+        printf("%.1f,%d\n", p->settle, p->stable);
+    }
+    fflush(stdout);
+}
+
+static void on_signal(int sig)
+{
+    (void)sig;
+    stop = 1;
+}
+
+static void usage(const char *prog)
+{
+    fprintf(stderr, "Usage: %s [-S] [-G] [-j] [-f from] [-t to] [-d step] [-w samples] [-T tolerance]\n"
+            "       [-m max wait] [-l bench s] [-a abort C] [-c PLL constant]\n"
+            "       [-p proc dir] [-B battery dir]\n"
+            "  -S  run against the simulated backend instead of the module\n"
+            "  -G  turn memgov/loadgov off for the sweep instead of refusing to run\n"
+            "  -j  JSON output instead of CSV\n"
+            "  -f, -t, -d  clock range and step [MHz] (default the full range, 50)\n"
+            "  -w  temperature samples, one per second, that must agree (default %d)\n"
+            "  -T  allowed temperature spread over them [C] (default %.1f)\n"
+            "  -m  give up waiting for a stable temperature after [s] (default %.0f)\n"
+            "  -l  length of each benchmark [s] (default %.0f)\n"
+            "  -a  stop the sweep at this temperature [C] (default %d)\n"
+            "  -c  PLL constant for the default range (default %d.%03d)\n"
+            "  -p  module proc directory (default %s)\n"
+            "  -B  battery sysfs directory (default %s)\n",
+            prog, window, tolerance, max_wait, bench_sec, abort_temp,
+            const_milli / 1000, const_milli % 1000, proc_dir, bat_dir);
+    exit(1);
+}
+
+int main(int argc, char *argv[])
+{
+    const struct backend *be = &proc_backend;
+    struct point p;
+    int from = 0, to = 0, step = 50;
+    int json = 0, first = 1, orig, mhz, opt, ret = 0;
+    int gov_off = 0, gov_mask, i;
+
+    while ((opt = getopt(argc, argv, "SGjf:t:d:w:T:m:l:a:c:p:B:")) != -1) {
+        switch (opt) {
+        case 'S': be = &sim_backend; break;
+        case 'G': gov_off = 1; break;
+        case 'j': json = 1; break;
+        case 'f': from = atoi(optarg); break;
+        case 't': to = atoi(optarg); break;
+        case 'd': step = atoi(optarg); break;
+        case 'w': window = atoi(optarg); break;
+        case 'T': tolerance = atof(optarg); break;
+        case 'm': max_wait = atof(optarg); break;
+        case 'l': bench_sec = atof(optarg); break;
+        case 'a': abort_temp = atoi(optarg); break;
+        case 'c': const_milli = (int)(atof(optarg) * 1000); break;
+        case 'p': snprintf(proc_dir, sizeof(proc_dir), "%s", optarg); break;
+        case 'B': snprintf(bat_dir, sizeof(bat_dir), "%s", optarg); break;
+        default: usage(argv[0]);
+        }
+    }
+    if (from == 0)
+        from = mhz_of(50, eeefsb_plan_n_min(50));
+    if (to == 0)
+        to = mhz_of(49, eeefsb_plan_n_max(49));
+    if (optind != argc || step <= 0 || window <= 0 || bench_sec <= 0 ||
+        const_milli <= 0 || from > to)
+        usage(argv[0]);
+
+    if (be == &proc_backend && bench_setup()) {
+        perror("malloc");
+        return 1;
+    }
+    orig = be->read_freq();
+    if (orig <= 0) {
+        fprintf(stderr, "%s: can't read the CPU clock from %s\n", argv[0], proc_dir);
+        return 1;
+    }
+
+    /* A governor would move the clock under us */
+    gov_mask = be->governors(gov_off);
+    for (i = 0; i < NR_GOVERNORS; i++) {
+        if (!(gov_mask & (1 << i)))
+            continue;
+        if (!gov_off) {
+            fprintf(stderr, "%s: %s is enabled, turn it off or use -G\n",
+                    argv[0], governor_names[i]);
+            return 1;
+        }
+        fprintf(stderr, "# %s turned off for the sweep\n", governor_names[i]);
+    }
+    signal(SIGINT, on_signal);
+    signal(SIGTERM, on_signal);
+
+    fprintf(stderr, "# %s backend, %d..%d MHz in %d MHz steps, now at %d MHz\n",
+            be->name, from, to, step, orig);
+    if (json)
+        printf("[");
+    else
+        printf("target,mhz,%s,%s,%s,score,temp_c,fan_duty,fan_rpm,power_mw,"
+               "score_per_w,settle_s,stable\n",
+               bench_names[0], bench_names[1], bench_names[2]);
+
+    for (mhz = from; mhz <= to && !stop; mhz += step) {
+        ret = measure(be, mhz, &p);
+        if (ret)
+            break;
+        print_point(&p, json, first);
+        first = 0;
+        fprintf(stderr, "# %d MHz: score %.2f at %.1f C\n", p.mhz,
+                composite(&p), p.temp);
+    }
+    if (json)
+        printf("\n]\n");
+
+    /* Back to where we started, no matter how we got here */
+    be->set_freq(orig);
+    be->restore_governors(gov_mask);
+    return (ret < 0) ? 1 : 0;
+}